@@ -2,8 +2,12 @@
 using namespace Rcpp;
 
 #include "Collector.h"
+#include "DictionaryVector.h"
+#include "DoubleParser.h"
+#include "IntegerParser.h"
 #include "LocaleInfo.h"
 #include "QiParsers.h"
+#include <algorithm>
 
 CollectorPtr Collector::create(List spec, LocaleInfo* pLocale) {
   std::string subclass(as<CharacterVector>(spec.attr("class"))[0]);
@@ -20,8 +24,11 @@ CollectorPtr Collector::create(List spec, LocaleInfo* pLocale) {
   if (subclass == "collector_number")
     return CollectorPtr(
         new CollectorNumeric(pLocale->decimalMark_, pLocale->groupingMark_));
-  if (subclass == "collector_character")
+  if (subclass == "collector_character") {
+    if (spec.containsElementNamed("dict") && as<bool>(spec["dict"]))
+      return CollectorPtr(new CollectorCharacterDict(&pLocale->encoder_));
     return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
   if (subclass == "collector_date") {
     SEXP format_ = spec["format"];
     std::string format =
@@ -60,28 +67,207 @@ collectorsCreate(ListOf<List> specs, LocaleInfo* pLocale) {
   return collectors;
 }
 
+void Collector::setValues(const TokenBatch& batch, int col, int offset) {
+  const std::vector<int>& index = batch.column(col);
+  for (size_t k = 0; k < index.size(); ++k) {
+    int i = index[k];
+    setValue(batch.row(i) - offset, batch.token(i));
+  }
+}
+
+void Collector::resize(int n) {
+  if (type_ == NILSXP)
+    return;
+
+  if (joined_) {
+    joined_ = false;
+    n_ = 0;
+  }
+  if (n == n_)
+    return;
+
+  // Shrinking keeps the chunks, the elements past the end are reset if the
+  // column grows again
+  if (n > n_) {
+    reserve(n);
+    fillNA(n_, n);
+  }
+  n_ = n;
+}
+
+void Collector::reserve(int n) {
+  size_t chunks = (n + CHUNK_SIZE - 1) >> CHUNK_BITS;
+  int first = chunks > 1 ? (int)CHUNK_SIZE : n;
+  if (chunks_.empty()) {
+    setChunk(0, Rf_allocVector(type_, first));
+  } else if (Rf_xlength(chunks_[0]) < first) {
+    setChunk(0, Rf_lengthgets(chunks_[0], first));
+  }
+
+  while (chunks_.size() < chunks) {
+    setChunk(chunks_.size(), Rf_allocVector(type_, CHUNK_SIZE));
+  }
+}
+
+void Collector::setChunk(size_t k, SEXP chunk) {
+  if (k == chunks_.size()) {
+    chunks_.push_back(Rcpp::RObject());
+    data_.push_back(NULL);
+  }
+  chunks_[k] = chunk;
+
+  switch (type_) {
+  case REALSXP:
+    data_[k] = REAL(chunk);
+    break;
+  case INTSXP:
+    data_[k] = INTEGER(chunk);
+    break;
+  case LGLSXP:
+    data_[k] = LOGICAL(chunk);
+    break;
+  default:
+    break;
+  }
+}
+
+void Collector::fillNA(int from, int to) {
+  for (int i = from; i < to;) {
+    SEXP chunk = chunks_[i >> CHUNK_BITS];
+    int begin = i & (CHUNK_SIZE - 1);
+    int end = std::min(begin + (to - i), (int)Rf_xlength(chunk));
+
+    switch (type_) {
+    case REALSXP:
+      std::fill(REAL(chunk) + begin, REAL(chunk) + end, NA_REAL);
+      break;
+    case INTSXP:
+      std::fill(INTEGER(chunk) + begin, INTEGER(chunk) + end, NA_INTEGER);
+      break;
+    case LGLSXP:
+      std::fill(LOGICAL(chunk) + begin, LOGICAL(chunk) + end, NA_LOGICAL);
+      break;
+    case STRSXP:
+      for (int j = begin; j < end; ++j)
+        SET_STRING_ELT(chunk, j, NA_STRING);
+      break;
+    case VECSXP:
+      for (int j = begin; j < end; ++j)
+        SET_VECTOR_ELT(chunk, j, R_NilValue);
+      break;
+    default:
+      Rcpp::stop("Unsupported column type");
+    }
+
+    i += end - begin;
+  }
+}
+
+Rcpp::RObject Collector::vector() {
+  if (joined_ || type_ == NILSXP)
+    return column_;
+
+  if (chunks_.size() == 1 && Rf_xlength(chunks_[0]) == n_) {
+    // The only chunk is already the column
+    column_ = chunks_[0];
+  } else {
+    column_ = Rf_allocVector(type_, n_);
+    for (size_t k = 0; k < chunks_.size(); ++k) {
+      SEXP chunk = chunks_[k];
+      int begin = k << CHUNK_BITS;
+      int m = std::min((int)Rf_xlength(chunk), n_ - begin);
+
+      switch (type_) {
+      case REALSXP:
+        std::copy(REAL(chunk), REAL(chunk) + m, REAL(column_) + begin);
+        break;
+      case INTSXP:
+        std::copy(INTEGER(chunk), INTEGER(chunk) + m, INTEGER(column_) + begin);
+        break;
+      case LGLSXP:
+        std::copy(LOGICAL(chunk), LOGICAL(chunk) + m, LOGICAL(column_) + begin);
+        break;
+      case STRSXP:
+        for (int j = 0; j < m; ++j)
+          SET_STRING_ELT(column_, begin + j, STRING_ELT(chunk, j));
+        break;
+      case VECSXP:
+        for (int j = 0; j < m; ++j)
+          SET_VECTOR_ELT(column_, begin + j, VECTOR_ELT(chunk, j));
+        break;
+      default:
+        Rcpp::stop("Unsupported column type");
+      }
+
+      // Release each chunk once it is copied, to keep the peak memory down
+      chunks_[k] = R_NilValue;
+      if (begin + m == n_)
+        break;
+    }
+  }
+
+  std::vector<Rcpp::RObject>().swap(chunks_);
+  std::vector<void*>().swap(data_);
+  joined_ = true;
+  return column_;
+}
+
 // Implementations ------------------------------------------------------------
 
+SEXP CollectorCharacter::makeSEXP(
+    const char* begin, const char* end, bool hasNull) {
+  if (!useCache_)
+    return pEncoder_->makeSEXP(begin, end, hasNull);
+
+  // Check the hit rate of each window of lookups, once the cache has had a
+  // chance to fill
+  if (lookups_ == CACHE_WINDOW) {
+    if (hits_ < CACHE_WINDOW / 2) {
+      useCache_ = false;
+      cacheIndex_.clear();
+      cache_ = Rcpp::CharacterVector();
+      return pEncoder_->makeSEXP(begin, end, hasNull);
+    }
+    lookups_ = hits_ = 0;
+  }
+  ++lookups_;
+
+  int k;
+  if (cacheIndex_.find(begin, end, &k)) {
+    ++hits_;
+    return STRING_ELT(cache_, k);
+  }
+
+  if (cacheIndex_.size() >= CACHE_SIZE)
+    return pEncoder_->makeSEXP(begin, end, hasNull);
+
+  // Allocated before the string is made, so it can't be collected
+  if (cache_.size() == 0)
+    cache_ = Rcpp::CharacterVector(CACHE_SIZE);
+
+  SEXP string = pEncoder_->makeSEXP(begin, end, hasNull);
+  k = cacheIndex_.size();
+  SET_STRING_ELT(cache_, k, string);
+  cacheIndex_.insert(begin, end, k);
+  return string;
+}
+
 void CollectorCharacter::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
 
     if (t.hasNull())
       warn(t.row(), t.col(), "", "embedded null");
 
-    SET_STRING_ELT(
-        column_,
-        i,
-        pEncoder_->makeSEXP(string.first, string.second, t.hasNull()));
+    setString(i, makeSEXP(string.first, string.second, t.hasNull()));
     break;
   };
   case TOKEN_MISSING:
-    SET_STRING_ELT(column_, i, NA_STRING);
+    setString(i, NA_STRING);
     break;
   case TOKEN_EMPTY:
-    SET_STRING_ELT(column_, i, Rf_mkCharCE("", CE_UTF8));
+    setString(i, Rf_mkCharCE("", CE_UTF8));
     break;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -89,38 +275,79 @@ void CollectorCharacter::setValue(int i, const Token& t) {
 }
 
 void CollectorCharacter::setValue(int i, const std::string& s) {
-  SET_STRING_ELT(column_, i, Rf_mkCharCE(s.c_str(), CE_UTF8));
+  setString(i, Rf_mkCharCE(s.c_str(), CE_UTF8));
 }
 
-void CollectorDate::setValue(int i, const Token& t) {
+int CollectorCharacterDict::code(
+    const char* begin, const char* end, bool hasNull) {
+  int k;
+  if (codes_.find(begin, end, &k))
+    return k;
+
+  if (size_ == dictionary_.size()) {
+    int n = size_ == 0 ? 64 : size_ * 2;
+    dictionary_ = Rf_lengthgets(dictionary_, n);
+  }
+
+  k = size_++;
+  SET_STRING_ELT(dictionary_, k, pEncoder_->makeSEXP(begin, end, hasNull));
+  codes_.insert(begin, end, k);
+  return k;
+}
+
+void CollectorCharacterDict::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
-    std::string std_string(string.first, string.second);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
 
-    parser_.setDate(std_string.c_str());
-    bool res =
-        (format_ == "") ? parser_.parseLocaleDate() : parser_.parse(format_);
+    if (t.hasNull())
+      warn(t.row(), t.col(), "", "embedded null");
 
-    if (!res) {
-      warn(t.row(), t.col(), "date like " + format_, std_string);
-      REAL(column_)[i] = NA_REAL;
+    integer(i) = code(string.first, string.second, t.hasNull());
+    break;
+  };
+  case TOKEN_MISSING:
+    integer(i) = NA_INTEGER;
+    break;
+  case TOKEN_EMPTY: {
+    const char* empty = "";
+    integer(i) = code(empty, empty, false);
+    break;
+  }
+  case TOKEN_EOF:
+    Rcpp::stop("Invalid token");
+  }
+}
+
+Rcpp::RObject CollectorCharacterDict::vector() {
+  Rcpp::CharacterVector dictionary = Rf_lengthgets(dictionary_, size_);
+  return makeDictionaryVector(Collector::vector(), dictionary);
+}
+
+void CollectorDate::setValue(int i, const Token& t) {
+  switch (t.type()) {
+  case TOKEN_STRING: {
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
+
+    parser_.setDate(string.first, string.second);
+    if (!parser_.parse(compiled_)) {
+      warn(t, expected_.c_str(), string);
+      real(i) = NA_REAL;
       return;
     }
 
     DateTime dt = parser_.makeDate();
     if (!dt.validDate()) {
-      warn(t.row(), t.col(), "valid date", std_string);
-      REAL(column_)[i] = NA_REAL;
+      warn(t, "valid date", string);
+      real(i) = NA_REAL;
       return;
     }
-    REAL(column_)[i] = dt.date();
+    real(i) = dt.date();
     return;
   }
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    REAL(column_)[i] = NA_REAL;
+    real(i) = NA_REAL;
     return;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -130,33 +357,37 @@ void CollectorDate::setValue(int i, const Token& t) {
 void CollectorDateTime::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
-    std::string std_string(string.first, string.second);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
 
-    parser_.setDate(std_string.c_str());
-    bool res =
-        (format_ == "") ? parser_.parseISO8601() : parser_.parse(format_);
+    parser_.setDate(string.first, string.second);
+    bool res = (format_ == "") ? parser_.parseISO8601()
+                               : parser_.parse(compiled_);
 
     if (!res) {
-      warn(t.row(), t.col(), "date like " + format_, std_string);
-      REAL(column_)[i] = NA_REAL;
+      warn(t, expected_.c_str(), string);
+      real(i) = NA_REAL;
       return;
     }
 
     DateTime dt = parser_.makeDateTime();
     if (!dt.validDateTime()) {
-      warn(t.row(), t.col(), "valid date", std_string);
-      REAL(column_)[i] = NA_REAL;
+      warn(t, "valid date", string);
+      real(i) = NA_REAL;
       return;
     }
 
-    REAL(column_)[i] = dt.datetime();
+    // Skipped when the clocks went forward
+    double value = dt.datetime();
+    if (ISNAN(value)) {
+      warn(t, "time that exists in its time zone", string);
+    }
+
+    real(i) = value;
     return;
   }
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    REAL(column_)[i] = NA_REAL;
+    real(i) = NA_REAL;
     return;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -168,20 +399,19 @@ void CollectorDateTime::setValue(int i, const Token& t) {
 void CollectorDouble::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators str = t.getString(&buffer);
+    SourceIterators str = t.getString(&buffer_, pWarnings_);
 
     bool ok =
-        parseDouble(decimalMark_, str.first, str.second, REAL(column_)[i]);
+        parseDouble(decimalMark_, str.first, str.second, real(i));
     if (!ok) {
-      REAL(column_)[i] = NA_REAL;
-      warn(t.row(), t.col(), "a double", str);
+      real(i) = NA_REAL;
+      warn(t, "a double", str);
       return;
     }
 
     if (str.first != str.second) {
-      REAL(column_)[i] = NA_REAL;
-      warn(t.row(), t.col(), "no trailing characters", str);
+      real(i) = NA_REAL;
+      warn(t, "no trailing characters", str);
       return;
     }
 
@@ -189,28 +419,27 @@ void CollectorDouble::setValue(int i, const Token& t) {
   }
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    REAL(column_)[i] = NA_REAL;
+    real(i) = NA_REAL;
     break;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
   }
 }
 
-void CollectorFactor::insert(int i, Rcpp::String str, const Token& t) {
+// Returns the index of str in the levels, adding it if the levels are
+// implicit, or -1 if it is not in the level set
+int CollectorFactor::level(Rcpp::String str) {
   std::map<Rcpp::String, int>::iterator it = levelset_.find(str);
-  if (it == levelset_.end()) {
-    if (implicitLevels_ || (includeNa_ && str == NA_STRING)) {
-      int n = levelset_.size();
-      levelset_.insert(std::make_pair(str, n));
-      levels_.push_back(str);
-      INTEGER(column_)[i] = n + 1;
-    } else {
-      warn(t.row(), t.col(), "value in level set", str);
-      INTEGER(column_)[i] = NA_INTEGER;
-    }
-  } else {
-    INTEGER(column_)[i] = it->second + 1;
+  if (it != levelset_.end())
+    return it->second;
+
+  if (implicitLevels_ || (includeNa_ && str == NA_STRING)) {
+    int n = levelset_.size();
+    levelset_.insert(std::make_pair(str, n));
+    levels_.push_back(str);
+    return n;
   }
+  return -1;
 }
 
 void CollectorFactor::setValue(int i, const Token& t) {
@@ -218,21 +447,30 @@ void CollectorFactor::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_EMPTY:
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
 
-    Rcpp::String std_string =
-        pEncoder_->makeSEXP(string.first, string.second, t.hasNull());
-    insert(i, std_string, t);
-    return;
-  };
-  case TOKEN_MISSING:
-    if (includeNa_) {
-      insert(i, NA_STRING, t);
+    // Only strings that haven't been seen before are converted to a CHARSXP
+    int n;
+    if (!rawLevels_.find(string.first, string.second, &n)) {
+      n = level(pEncoder_->makeSEXP(string.first, string.second, t.hasNull()));
+      rawLevels_.insert(string.first, string.second, n);
+    }
+
+    if (n < 0) {
+      Rcpp::String std_string =
+          pEncoder_->makeSEXP(string.first, string.second, t.hasNull());
+      warn(t.row(), t.col(), "value in level set", std_string);
+      integer(i) = NA_INTEGER;
     } else {
-      INTEGER(column_)[i] = NA_INTEGER;
+      integer(i) = n + 1;
     }
     return;
+  };
+  case TOKEN_MISSING: {
+    int n = includeNa_ ? level(NA_STRING) : -1;
+    integer(i) = n < 0 ? NA_INTEGER : n + 1;
+    return;
+  }
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
   }
@@ -242,19 +480,18 @@ void CollectorInteger::setValue(int i, const Token& t) {
 
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators str = t.getString(&buffer);
+    SourceIterators str = t.getString(&buffer_, pWarnings_);
 
-    bool ok = parseInt(str.first, str.second, INTEGER(column_)[i]);
+    bool ok = parseInt(str.first, str.second, integer(i));
     if (!ok) {
-      INTEGER(column_)[i] = NA_INTEGER;
-      warn(t.row(), t.col(), "an integer", str);
+      integer(i) = NA_INTEGER;
+      warn(t, "an integer", str);
       return;
     }
 
     if (str.first != str.second) {
-      warn(t.row(), t.col(), "no trailing characters", str);
-      INTEGER(column_)[i] = NA_INTEGER;
+      warn(t, "no trailing characters", str);
+      integer(i) = NA_INTEGER;
       return;
     }
 
@@ -262,7 +499,7 @@ void CollectorInteger::setValue(int i, const Token& t) {
   };
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    INTEGER(column_)[i] = NA_INTEGER;
+    integer(i) = NA_INTEGER;
     break;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -273,28 +510,27 @@ void CollectorLogical::setValue(int i, const Token& t) {
 
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
     int size = string.second - string.first;
 
     if (Rf_StringTrue(string.first) ||
         (size == 1 && (*string.first == '1') || *string.first == 't')) {
-      LOGICAL(column_)[i] = 1;
+      logical(i) = 1;
       return;
     }
     if (Rf_StringFalse(string.first) ||
         (size == 1 && (*string.first == '0') || *string.first == 'f')) {
-      LOGICAL(column_)[i] = 0;
+      logical(i) = 0;
       return;
     }
 
-    warn(t.row(), t.col(), "1/0/T/F/TRUE/FALSE", string);
-    LOGICAL(column_)[i] = NA_LOGICAL;
+    warn(t, "1/0/T/F/TRUE/FALSE", string);
+    logical(i) = NA_LOGICAL;
     return;
   };
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    LOGICAL(column_)[i] = NA_LOGICAL;
+    logical(i) = NA_LOGICAL;
     return;
     break;
   case TOKEN_EOF:
@@ -305,15 +541,14 @@ void CollectorLogical::setValue(int i, const Token& t) {
 void CollectorNumeric::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators str = t.getString(&buffer);
+    SourceIterators str = t.getString(&buffer_, pWarnings_);
 
     bool ok = parseNumber(
-        decimalMark_, groupingMark_, str.first, str.second, REAL(column_)[i]);
+        decimalMark_, groupingMark_, str.first, str.second, real(i));
 
     if (!ok) {
-      REAL(column_)[i] = NA_REAL;
-      warn(t.row(), t.col(), "a number", str);
+      real(i) = NA_REAL;
+      warn(t, "a number", str);
       return;
     }
 
@@ -321,7 +556,7 @@ void CollectorNumeric::setValue(int i, const Token& t) {
   }
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    REAL(column_)[i] = NA_REAL;
+    real(i) = NA_REAL;
     break;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -331,32 +566,27 @@ void CollectorNumeric::setValue(int i, const Token& t) {
 void CollectorTime::setValue(int i, const Token& t) {
   switch (t.type()) {
   case TOKEN_STRING: {
-    boost::container::string buffer;
-    SourceIterators string = t.getString(&buffer);
-    std::string std_string(string.first, string.second);
-
-    parser_.setDate(std_string.c_str());
-    bool res =
-        (format_ == "") ? parser_.parseLocaleTime() : parser_.parse(format_);
+    SourceIterators string = t.getString(&buffer_, pWarnings_);
 
-    if (!res) {
-      warn(t.row(), t.col(), "time like " + format_, std_string);
-      REAL(column_)[i] = NA_REAL;
+    parser_.setDate(string.first, string.second);
+    if (!parser_.parse(compiled_)) {
+      warn(t, expected_.c_str(), string);
+      real(i) = NA_REAL;
       return;
     }
 
     DateTime dt = parser_.makeTime();
     if (!dt.validTime()) {
-      warn(t.row(), t.col(), "valid date", std_string);
-      REAL(column_)[i] = NA_REAL;
+      warn(t, "valid date", string);
+      real(i) = NA_REAL;
       return;
     }
-    REAL(column_)[i] = dt.time();
+    real(i) = dt.time();
     return;
   }
   case TOKEN_MISSING:
   case TOKEN_EMPTY:
-    REAL(column_)[i] = NA_REAL;
+    real(i) = NA_REAL;
     return;
   case TOKEN_EOF:
     Rcpp::stop("Invalid token");
@@ -367,6 +597,30 @@ void CollectorRaw::setValue(int i, const Token& t) {
   if (t.type() == TOKEN_EOF) {
     Rcpp::stop("Invalid token");
   }
-  SET_VECTOR_ELT(column_, i, t.asRaw());
+  setElement(i, t.asRaw());
   return;
 }
+
+template <class T>
+void TypedCollector<T>::setValues(
+    const TokenBatch& batch, int col, int offset) {
+  T* pCollector = static_cast<T*>(this);
+  const std::vector<int>& index = batch.column(col);
+  for (size_t k = 0; k < index.size(); ++k) {
+    int i = index[k];
+    pCollector->T::setValue(batch.row(i) - offset, batch.token(i));
+  }
+}
+
+// The collectors created by Collector::create()
+template class TypedCollector<CollectorCharacter>;
+template class TypedCollector<CollectorCharacterDict>;
+template class TypedCollector<CollectorDate>;
+template class TypedCollector<CollectorDateTime>;
+template class TypedCollector<CollectorDouble>;
+template class TypedCollector<CollectorFactor>;
+template class TypedCollector<CollectorInteger>;
+template class TypedCollector<CollectorLogical>;
+template class TypedCollector<CollectorNumeric>;
+template class TypedCollector<CollectorTime>;
+template class TypedCollector<CollectorRaw>;
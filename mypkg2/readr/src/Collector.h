@@ -5,7 +5,9 @@
 #include "DateTimeParser.h"
 #include "Iconv.h"
 #include "LocaleInfo.h"
+#include "RawStringMap.h"
 #include "Token.h"
+#include "TokenBatch.h"
 #include "Warnings.h"
 #include <Rcpp.h>
 #include <boost/shared_ptr.hpp>
@@ -15,47 +17,99 @@ typedef boost::shared_ptr<Collector> CollectorPtr;
 
 class Collector {
 protected:
+  // The values are set in chunks of CHUNK_SIZE elements, which are vectors of
+  // the type of column_, so that growing the column never copies the values
+  // already set, and the garbage collector only rescans the chunks that
+  // changed. vector() joins them into column_. The first chunk grows with
+  // the column until it is full, so short columns stay small.
+  enum { CHUNK_BITS = 16, CHUNK_SIZE = 1 << CHUNK_BITS };
   Rcpp::RObject column_;
+  SEXPTYPE type_;
+  std::vector<Rcpp::RObject> chunks_;
+  std::vector<void*> data_;
+  bool joined_;
+
   Warnings* pWarnings_;
 
   int n_;
 
+  // Number of values that failed to convert
+  int failures_;
+
+  // Escaped values are unescaped into buffer_, which is reused from value
+  // to value
+  boost::container::string buffer_;
+
+  // Element i of a column of doubles, integers or logicals
+  double& real(int i) {
+    return static_cast<double*>(data_[i >> CHUNK_BITS])[i & (CHUNK_SIZE - 1)];
+  }
+  int& integer(int i) {
+    return static_cast<int*>(data_[i >> CHUNK_BITS])[i & (CHUNK_SIZE - 1)];
+  }
+  int& logical(int i) { return integer(i); }
+
+  // Sets element i of a column of strings or a list
+  void setString(int i, SEXP x) {
+    SET_STRING_ELT(chunks_[i >> CHUNK_BITS], i & (CHUNK_SIZE - 1), x);
+  }
+  void setElement(int i, SEXP x) {
+    SET_VECTOR_ELT(chunks_[i >> CHUNK_BITS], i & (CHUNK_SIZE - 1), x);
+  }
+
 public:
   Collector(SEXP column, Warnings* pWarnings = NULL)
-      : column_(column), pWarnings_(pWarnings), n_(0) {}
+      : column_(column),
+        type_(TYPEOF(column)),
+        joined_(false),
+        pWarnings_(pWarnings),
+        n_(0),
+        failures_(0) {}
 
   virtual ~Collector(){};
 
   virtual void setValue(int i, const Token& t) = 0;
 
-  virtual Rcpp::RObject vector() { return column_; };
+  // Sets the values of column col of batch; the token on row r goes to
+  // element r - offset
+  virtual void setValues(const TokenBatch& batch, int col, int offset);
+
+  // The column, made from the chunks the first time it is called. The
+  // chunks are released, so the collector starts again from an empty column
+  // when it is next resized.
+  virtual Rcpp::RObject vector();
 
   virtual bool skip() { return false; }
 
-  int size() { return n_; }
+  // Whether the column can be converted after the file is read, when it is
+  // first used. Its type and attributes must not depend on its values.
+  virtual bool lazy() { return true; }
 
-  void resize(int n) {
-    // Rcpp::Rcerr << "Resizing to: " << n << std::endl;
-    if (n == n_)
-      return;
+  // A collector of the next wider type, which reads every value this one
+  // reads and more, or NULL if there is none. promotedType() is its name
+  // in cols().
+  virtual CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr();
+  }
+  virtual const char* promotedType() const { return NULL; }
 
-    if (column_ == R_NilValue)
-      return;
+  int failures() const { return failures_; }
 
-    if (n > 0 && n < n_) {
-      SETLENGTH(column_, n);
-      SET_TRUELENGTH(column_, n);
-    } else {
-      column_ = Rf_lengthgets(column_, n);
-    }
-    n_ = n;
-  }
+  int size() { return n_; }
+
+  // Elements added by growing the column are NA
+  void resize(int n);
 
   void clear() { resize(0); }
 
   void setWarnings(Warnings* pWarnings) { pWarnings_ = pWarnings; }
 
-  inline void warn(int row, int col, std::string expected, std::string actual) {
+  inline void warn(
+      int row,
+      int col,
+      const std::string& expected,
+      const std::string& actual) {
+    ++failures_;
     if (pWarnings_ == NULL) {
       Rcpp::warning(
           "[%i, %i]: expected %s, but got '%s'",
@@ -68,39 +122,123 @@ public:
 
     pWarnings_->addWarning(row, col, expected, actual);
   }
+
+  // A failure to convert t, of which actual is what was left of its value.
+  // Unless the value was unescaped into a buffer, it is kept as a slice of
+  // the input until the problems are returned.
   inline void
-  warn(int row, int col, std::string expected, SourceIterators actual) {
-    warn(row, col, expected, std::string(actual.first, actual.second));
+  warn(const Token& t, const char* expected, SourceIterators actual) {
+    if (pWarnings_ == NULL || t.isEscaped()) {
+      warn(
+          t.row(),
+          t.col(),
+          expected,
+          std::string(actual.first, actual.second));
+      return;
+    }
+
+    ++failures_;
+    pWarnings_->addWarning(
+        t.row(), t.col(), expected, actual.first, actual.second);
   }
 
   static CollectorPtr create(Rcpp::List spec, LocaleInfo* pLocale);
+
+private:
+  void reserve(int n);
+  void setChunk(size_t k, SEXP chunk);
+  // Sets elements [from, to) to NA
+  void fillNA(int from, int to);
+};
+
+// Base of the collectors of type T, whose setValues() calls T::setValue()
+// directly, so that it can be inlined into the loop over the column. The
+// definition is instantiated for each T at the end of Collector.cpp.
+template <class T> class TypedCollector : public Collector {
+public:
+  TypedCollector(SEXP column, Warnings* pWarnings = NULL)
+      : Collector(column, pWarnings) {}
+
+  void setValues(const TokenBatch& batch, int col, int offset);
 };
 
 // Character -------------------------------------------------------------------
 
-class CollectorCharacter : public Collector {
+class CollectorCharacter : public TypedCollector<CollectorCharacter> {
   Iconv* pEncoder_;
 
+  // Strings already made for this column, keyed on their bytes in the file,
+  // so repeated values skip transcoding and R's global string hash. cache_
+  // holds the CHARSXPs, and keeps them alive; cacheIndex_ maps to their
+  // positions in it. The cache turns itself off for good if too few values
+  // are found in it.
+  enum { CACHE_SIZE = 4096, CACHE_WINDOW = 1024 };
+  RawStringMap cacheIndex_;
+  Rcpp::CharacterVector cache_;
+  bool useCache_;
+  int lookups_, hits_;
+
+  SEXP makeSEXP(const char* begin, const char* end, bool hasNull);
+
 public:
   CollectorCharacter(Iconv* pEncoder)
-      : Collector(Rcpp::CharacterVector()), pEncoder_(pEncoder) {}
+      : TypedCollector<CollectorCharacter>(Rcpp::CharacterVector()),
+        pEncoder_(pEncoder),
+        useCache_(true),
+        lookups_(0),
+        hits_(0) {}
   void setValue(int i, const Token& t);
   void setValue(int i, const std::string& s);
 };
 
+// Stores the column as codes into a dictionary of its distinct values, like
+// the levels of a factor, and returns it as a DictionaryVector
+class CollectorCharacterDict : public TypedCollector<CollectorCharacterDict> {
+  Iconv* pEncoder_;
+
+  // Code of each string seen so far, keyed on its bytes in the file. The
+  // first size_ elements of dictionary_ are in use.
+  RawStringMap codes_;
+  Rcpp::CharacterVector dictionary_;
+  int size_;
+
+  int code(const char* begin, const char* end, bool hasNull);
+
+public:
+  CollectorCharacterDict(Iconv* pEncoder)
+      : TypedCollector<CollectorCharacterDict>(Rcpp::IntegerVector()),
+        pEncoder_(pEncoder),
+        size_(0) {}
+  void setValue(int i, const Token& t);
+  Rcpp::RObject vector();
+  bool lazy() { return false; }
+};
+
 // Date ------------------------------------------------------------------------
 
-class CollectorDate : public Collector {
-  std::string format_;
+class CollectorDate : public TypedCollector<CollectorDate> {
+  std::string expected_;
+  DateTimeFormat compiled_;
   DateTimeParser parser_;
 
 public:
   CollectorDate(LocaleInfo* pLocale, const std::string& format)
-      : Collector(Rcpp::NumericVector()), format_(format), parser_(pLocale) {}
+      : TypedCollector<CollectorDate>(Rcpp::NumericVector()),
+        expected_("date like " + format),
+        compiled_(
+            format.empty() ? pLocale->compiledDateFormat()
+                           : compileDateTimeFormat(format)),
+        parser_(pLocale) {}
 
   void setValue(int i, const Token& t);
 
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
+
   Rcpp::RObject vector() {
+    Collector::vector();
     column_.attr("class") = "Date";
     return column_;
   };
@@ -108,44 +246,62 @@ public:
 
 // Date time -------------------------------------------------------------------
 
-class CollectorDateTime : public Collector {
-  std::string format_;
+class CollectorDateTime : public TypedCollector<CollectorDateTime> {
+  std::string format_, expected_;
+  DateTimeFormat compiled_; // empty for ISO8601
   DateTimeParser parser_;
   std::string tz_;
 
 public:
   CollectorDateTime(LocaleInfo* pLocale, const std::string& format)
-      : Collector(Rcpp::NumericVector()),
+      : TypedCollector<CollectorDateTime>(Rcpp::NumericVector()),
         format_(format),
+        expected_("date like " + format),
+        compiled_(
+            format.empty() ? DateTimeFormat() : compileDateTimeFormat(format)),
         parser_(pLocale),
         tz_(pLocale->tz_) {}
 
   void setValue(int i, const Token& t);
 
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
+
   Rcpp::RObject vector() {
+    Collector::vector();
     column_.attr("class") = Rcpp::CharacterVector::create("POSIXct", "POSIXt");
     column_.attr("tzone") = tz_;
     return column_;
   };
 };
 
-class CollectorDouble : public Collector {
+class CollectorDouble : public TypedCollector<CollectorDouble> {
   char decimalMark_;
 
 public:
   CollectorDouble(char decimalMark)
-      : Collector(Rcpp::NumericVector()), decimalMark_(decimalMark) {}
+      : TypedCollector<CollectorDouble>(Rcpp::NumericVector()),
+        decimalMark_(decimalMark) {}
   void setValue(int i, const Token& t);
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
 };
 
-class CollectorFactor : public Collector {
+class CollectorFactor : public TypedCollector<CollectorFactor> {
   Iconv* pEncoder_;
   std::vector<Rcpp::String> levels_;
   std::map<Rcpp::String, int> levelset_;
   bool ordered_, implicitLevels_, includeNa_;
-  boost::container::string buffer_;
 
-  void insert(int i, Rcpp::String str, const Token& t);
+  // Level of each string seen so far, keyed on its bytes in the file, or -1
+  // if it is not in the level set
+  RawStringMap rawLevels_;
+
+  int level(Rcpp::String str);
 
 public:
   CollectorFactor(
@@ -153,7 +309,7 @@ public:
       Rcpp::Nullable<Rcpp::CharacterVector> levels,
       bool ordered,
       bool includeNa)
-      : Collector(Rcpp::IntegerVector()),
+      : TypedCollector<CollectorFactor>(Rcpp::IntegerVector()),
         pEncoder_(pEncoder),
         ordered_(ordered),
         includeNa_(includeNa) {
@@ -176,8 +332,10 @@ public:
     }
   }
   void setValue(int i, const Token& t);
+  bool lazy() { return false; }
 
   Rcpp::RObject vector() {
+    Collector::vector();
     if (ordered_) {
       column_.attr("class") =
           Rcpp::CharacterVector::create("ordered", "factor");
@@ -196,43 +354,69 @@ public:
   };
 };
 
-class CollectorInteger : public Collector {
+class CollectorInteger : public TypedCollector<CollectorInteger> {
 public:
-  CollectorInteger() : Collector(Rcpp::IntegerVector()) {}
+  CollectorInteger()
+      : TypedCollector<CollectorInteger>(Rcpp::IntegerVector()) {}
   void setValue(int i, const Token& t);
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorDouble(pLocale->decimalMark_));
+  }
+  const char* promotedType() const { return "double"; }
 };
 
-class CollectorLogical : public Collector {
+class CollectorLogical : public TypedCollector<CollectorLogical> {
 public:
-  CollectorLogical() : Collector(Rcpp::LogicalVector()) {}
+  CollectorLogical()
+      : TypedCollector<CollectorLogical>(Rcpp::LogicalVector()) {}
   void setValue(int i, const Token& t);
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
 };
 
-class CollectorNumeric : public Collector {
+class CollectorNumeric : public TypedCollector<CollectorNumeric> {
   char decimalMark_, groupingMark_;
 
 public:
   CollectorNumeric(char decimalMark, char groupingMark)
-      : Collector(Rcpp::NumericVector()),
+      : TypedCollector<CollectorNumeric>(Rcpp::NumericVector()),
         decimalMark_(decimalMark),
         groupingMark_(groupingMark) {}
   void setValue(int i, const Token& t);
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
   bool isNum(char c);
 };
 
 // Time ---------------------------------------------------------------------
 
-class CollectorTime : public Collector {
-  std::string format_;
+class CollectorTime : public TypedCollector<CollectorTime> {
+  std::string expected_;
+  DateTimeFormat compiled_;
   DateTimeParser parser_;
 
 public:
   CollectorTime(LocaleInfo* pLocale, const std::string& format)
-      : Collector(Rcpp::NumericVector()), format_(format), parser_(pLocale) {}
+      : TypedCollector<CollectorTime>(Rcpp::NumericVector()),
+        expected_("time like " + format),
+        compiled_(
+            format.empty() ? pLocale->compiledTimeFormat()
+                           : compileDateTimeFormat(format)),
+        parser_(pLocale) {}
 
   void setValue(int i, const Token& t);
 
+  CollectorPtr promote(LocaleInfo* pLocale) const {
+    return CollectorPtr(new CollectorCharacter(&pLocale->encoder_));
+  }
+  const char* promotedType() const { return "character"; }
+
   Rcpp::RObject vector() {
+    Collector::vector();
     column_.attr("class") = Rcpp::CharacterVector::create("hms", "difftime");
     column_.attr("units") = "secs";
     return column_;
@@ -245,14 +429,17 @@ class CollectorSkip : public Collector {
 public:
   CollectorSkip() : Collector(R_NilValue) {}
   void setValue(int i, const Token& t) {}
+  void setValues(const TokenBatch& batch, int col, int offset) {}
   bool skip() { return true; }
+  bool lazy() { return false; }
 };
 
 // Raw -------------------------------------------------------------------------
-class CollectorRaw : public Collector {
+class CollectorRaw : public TypedCollector<CollectorRaw> {
 public:
-  CollectorRaw() : Collector(Rcpp::List()) {}
+  CollectorRaw() : TypedCollector<CollectorRaw>(Rcpp::List()) {}
   void setValue(int i, const Token& t);
+  bool lazy() { return false; }
 };
 
 // Helpers ---------------------------------------------------------------------
@@ -3,90 +3,81 @@ using namespace Rcpp;
 
 #include "DateTime.h"
 #include "DateTimeParser.h"
+#include "DoubleParser.h"
 #include "LocaleInfo.h"
 #include "QiParsers.h"
 
-typedef bool (*canParseFun)(const std::string&, LocaleInfo* pLocale);
-
-bool canParse(
-    CharacterVector x, const canParseFun& canParse, LocaleInfo* pLocale) {
-  for (int i = 0; i < x.size(); ++i) {
-    if (x[i] == NA_STRING)
-      continue;
-
-    if (x[i].size() == 0)
-      continue;
-
-    if (!canParse(std::string(x[i]), pLocale))
-      return false;
-  }
-  return true;
+// The types a column can be guessed as, from strictest to most flexible.
+// Character is left out: any value can be parsed as one.
+enum GuessType {
+  GUESS_LOGICAL,
+  GUESS_DOUBLE,
+  GUESS_NUMBER,
+  GUESS_TIME,
+  GUESS_DATE,
+  GUESS_DATETIME,
+  GUESS_N
+};
+
+static const char* const guessTypeNames[GUESS_N + 1] = {
+    "logical", "double", "number", "time", "date", "datetime", "character"};
+
+static bool isLogical(const char* begin, const char* end) {
+  return Rf_StringTrue(begin) || Rf_StringFalse(begin);
 }
 
-bool allMissing(CharacterVector x) {
-  for (int i = 0; i < x.size(); ++i) {
-    if (x[i] != NA_STRING && x[i].size() > 0)
-      return false;
-  }
-  return true;
+// Leading zero not followed by decimal mark
+static bool hasLeadingZero(const char* begin, const char* end, char decimal) {
+  return begin[0] == '0' && end - begin > 1 && begin[1] != decimal;
 }
 
-bool isLogical(const std::string& x, LocaleInfo* pLocale) {
-  return Rf_StringTrue(x.c_str()) || Rf_StringFalse(x.c_str());
-}
-
-bool isNumber(const std::string& x, LocaleInfo* pLocale) {
-  // Leading zero not followed by decimal mark
-  if (x[0] == '0' && x.size() > 1 && x[1] != pLocale->decimalMark_)
+static bool isNumber(const char* begin, const char* end, LocaleInfo* pLocale) {
+  if (hasLeadingZero(begin, end, pLocale->decimalMark_))
     return false;
 
   double res = 0;
-  std::string::const_iterator begin = x.begin(), end = x.end();
+  const char *first = begin, *last = end;
 
   bool ok = parseNumber(
-      pLocale->decimalMark_, pLocale->groupingMark_, begin, end, res);
-  return ok && begin == x.begin() && end == x.end();
+      pLocale->decimalMark_, pLocale->groupingMark_, first, last, res);
+  return ok && first == begin && last == end;
 }
 
-bool isDouble(const std::string& x, LocaleInfo* pLocale) {
-  // Leading zero not followed by decimal mark
-  if (x[0] == '0' && x.size() > 1 && x[1] != pLocale->decimalMark_)
+static bool isDouble(const char* begin, const char* end, LocaleInfo* pLocale) {
+  if (hasLeadingZero(begin, end, pLocale->decimalMark_))
     return false;
 
   double res = 0;
-  std::string::const_iterator begin = x.begin(), end = x.end();
-
   return parseDouble(pLocale->decimalMark_, begin, end, res) && begin == end;
 }
 
-bool isTime(const std::string& x, LocaleInfo* pLocale) {
-  DateTimeParser parser(pLocale);
-
-  parser.setDate(x.c_str());
-  return parser.parseLocaleTime();
-}
-
-bool isDate(const std::string& x, LocaleInfo* pLocale) {
-  DateTimeParser parser(pLocale);
+// True if a value that parses as a double must also parse as a number, i.e.
+// it has no sign in front and nothing but digits, the decimal mark and an
+// exponent, all of which parseNumber() reads the same way.
+static bool isPlainDouble(const char* begin, const char* end, char decimal) {
+  if (*begin == '+')
+    return false;
 
-  parser.setDate(x.c_str());
-  return parser.parseLocaleDate();
+  for (const char* cur = begin; cur != end; ++cur) {
+    char c = *cur;
+    if (!((c >= '0' && c <= '9') || c == decimal || c == '-' || c == '+' ||
+          c == 'e' || c == 'E'))
+      return false;
+  }
+  return true;
 }
 
-static bool isDateTime(const std::string& x, LocaleInfo* pLocale) {
-  DateTimeParser parser(pLocale);
-
-  parser.setDate(x.c_str());
-  bool ok = parser.parseISO8601();
+static bool isDateTime(DateTimeParser* pParser) {
+  bool ok = pParser->parseISO8601();
 
   if (!ok)
     return false;
 
-  if (!parser.compactDate())
+  if (!pParser->compactDate())
     return true;
 
   // Values like 00014567 are unlikely to be dates, so don't guess
-  return parser.year() > 999;
+  return pParser->year() > 999;
 }
 
 // [[Rcpp::export]]
@@ -97,24 +88,62 @@ std::string collectorGuess(CharacterVector input, List locale_) {
     return "character";
   }
 
-  if (allMissing(input)) {
-    return "logical";
+  // Each value is checked against the types it could still be, so that it is
+  // read once rather than once per type, and the guess is over as soon as
+  // none are left.
+  DateTimeParser parser(&locale);
+  unsigned int possible = (1u << GUESS_N) - 1;
+  bool anyValue = false;
+
+  for (int i = 0; i < input.size() && possible != 0; ++i) {
+    SEXP string = STRING_ELT(input, i);
+    if (string == NA_STRING || LENGTH(string) == 0)
+      continue;
+    anyValue = true;
+
+    const char* begin = CHAR(string);
+    const char* end = begin + LENGTH(string);
+    bool isDoubleValue = false;
+
+    if (possible & (1u << GUESS_LOGICAL)) {
+      if (!isLogical(begin, end))
+        possible &= ~(1u << GUESS_LOGICAL);
+    }
+    if (possible & (1u << GUESS_DOUBLE)) {
+      isDoubleValue = isDouble(begin, end, &locale);
+      if (!isDoubleValue)
+        possible &= ~(1u << GUESS_DOUBLE);
+    }
+    if (possible & (1u << GUESS_NUMBER)) {
+      bool ok = (isDoubleValue && isPlainDouble(begin, end, locale.decimalMark_))
+          || isNumber(begin, end, &locale);
+      if (!ok)
+        possible &= ~(1u << GUESS_NUMBER);
+    }
+    if (possible & (1u << GUESS_TIME)) {
+      parser.setDate(begin, end);
+      if (!parser.parseLocaleTime())
+        possible &= ~(1u << GUESS_TIME);
+    }
+    if (possible & (1u << GUESS_DATE)) {
+      parser.setDate(begin, end);
+      if (!parser.parseLocaleDate())
+        possible &= ~(1u << GUESS_DATE);
+    }
+    if (possible & (1u << GUESS_DATETIME)) {
+      parser.setDate(begin, end);
+      if (!isDateTime(&parser))
+        possible &= ~(1u << GUESS_DATETIME);
+    }
   }
 
-  // Work from strictest to most flexible
-  if (canParse(input, isLogical, &locale))
+  if (!anyValue) {
     return "logical";
-  if (canParse(input, isDouble, &locale))
-    return "double";
-  if (canParse(input, isNumber, &locale))
-    return "number";
-  if (canParse(input, isTime, &locale))
-    return "time";
-  if (canParse(input, isDate, &locale))
-    return "date";
-  if (canParse(input, isDateTime, &locale))
-    return "datetime";
-
-  // Otherwise can always parse as a character
-  return "character";
+  }
+
+  // The strictest type that every value could be parsed as
+  int type = 0;
+  while (type < GUESS_N && !(possible & (1u << type)))
+    ++type;
+  return guessTypeNames[type];
 }
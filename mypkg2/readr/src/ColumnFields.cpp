@@ -0,0 +1,73 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "ColumnFields.h"
+
+#include <algorithm>
+
+void ColumnFields::append(const TokenBatch& batch, int offset) {
+  if (offset_ == -1)
+    offset_ = offset;
+  if ((size_t)col_ >= batch.columns())
+    return;
+
+  const std::vector<int>& tokens = batch.column(col_);
+  for (size_t k = 0; k < tokens.size(); ++k) {
+    size_t i = tokens[k], r = batch.row(i) - offset_;
+    if (r >= begin_.size()) {
+      begin_.resize(r + 1, NULL);
+      length_.resize(r + 1, 0);
+      flags_.resize(r + 1, TokenBatch::FLAG_MISSING);
+    }
+
+    begin_[r] = batch.begin(i);
+    length_[r] = batch.length(i);
+    flags_[r] = batch.flags(i);
+    if (flags_[r] & TokenBatch::FLAG_ESCAPED)
+      pTokenizer_ = batch.tokenizer();
+  }
+}
+
+void ColumnFields::reserve(int n) {
+  if ((size_t)n <= begin_.capacity())
+    return;
+
+  begin_.reserve(n);
+  length_.reserve(n);
+  flags_.reserve(n);
+}
+
+Token ColumnFields::token(int i) const {
+  int row = offset_ + i;
+  if (flags_[i] & TokenBatch::FLAG_MISSING)
+    return Token(TOKEN_MISSING, row, col_);
+
+  return Token(
+      begin_[i],
+      begin_[i] + length_[i],
+      row,
+      col_,
+      (flags_[i] & TokenBatch::FLAG_NULL) != 0,
+      (flags_[i] & TokenBatch::FLAG_ESCAPED) ? pTokenizer_ : NULL);
+}
+
+void ColumnFields::convert(Collector* pCollector, int n) const {
+  int m = std::min((size_t)n, begin_.size());
+  TokenBatch batch;
+  for (int i = 0; i < m; i += TokenBatch::DEFAULT_ROWS) {
+    batch.clear();
+    int end = std::min(m, i + (int)TokenBatch::DEFAULT_ROWS);
+    for (int k = i; k < end; ++k) {
+      batch.push_back(token(k));
+    }
+    pCollector->setValues(batch, col_, offset_);
+  }
+}
+
+void ColumnFields::clear() {
+  std::vector<SourceIterator>().swap(begin_);
+  std::vector<int>().swap(length_);
+  std::vector<unsigned char>().swap(flags_);
+  pTokenizer_ = NULL;
+  offset_ = -1;
+}
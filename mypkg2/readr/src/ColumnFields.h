@@ -0,0 +1,46 @@
+#ifndef FASTREAD_COLUMNFIELDS_H_
+#define FASTREAD_COLUMNFIELDS_H_
+
+#include "Collector.h"
+#include "Source.h"
+#include "TokenBatch.h"
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class ColumnFields;
+typedef boost::shared_ptr<ColumnFields> ColumnFieldsPtr;
+
+// The position, length and flags of the fields of one column, one per row,
+// so that they can be converted again later without tokenizing the input.
+// The source and the tokenizer used to unescape fields must outlive them.
+class ColumnFields {
+  int col_;
+
+  // One field per row, from row offset_. Rows without a field are missing.
+  std::vector<SourceIterator> begin_;
+  std::vector<int> length_;
+  std::vector<unsigned char> flags_;
+  Tokenizer* pTokenizer_;
+  int offset_;
+
+public:
+  ColumnFields(int col) : col_(col), pTokenizer_(NULL), offset_(-1) {}
+
+  // Record the fields of the column in batch, whose rows are counted from
+  // offset
+  void append(const TokenBatch& batch, int offset);
+
+  // Make room for the fields of n rows
+  void reserve(int n);
+
+  // Runs pCollector over the fields of the first n rows. Rows without a
+  // field are left as they are.
+  void convert(Collector* pCollector, int n) const;
+
+  void clear();
+
+private:
+  Token token(int i) const;
+};
+
+#endif
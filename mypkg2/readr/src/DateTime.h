@@ -1,6 +1,7 @@
 #ifndef READR_DATE_TIME_H_
 #define READR_DATE_TIME_H_
 
+#include "TimeZone.h"
 #include "localtime.h"
 #include <ctime>
 #include <stdlib.h>
@@ -52,6 +53,8 @@ class DateTime {
   int year_, mon_, day_, hour_, min_, sec_, offset_;
   double psec_;
   std::string tz_;
+  const TimeZone* pZone_;
+  TimeZone::Cache* pCache_;
 
 public:
   DateTime(
@@ -71,12 +74,21 @@ public:
         sec_(sec),
         offset_(0),
         psec_(psec),
-        tz_(tz) {}
+        tz_(tz),
+        pZone_(NULL),
+        pCache_(NULL) {}
 
   // Used to add time zone offsets which can only be easily applied once
   // we've converted into seconds since epoch.
   void setOffset(int offset) { offset_ = offset; }
 
+  // Converts local times with pZone, which must be the zone named by tz,
+  // rather than my_mktime(). pCache may be NULL.
+  void setTimeZone(const TimeZone* pZone, TimeZone::Cache* pCache) {
+    pZone_ = pZone;
+    pCache_ = pCache;
+  }
+
   // Is this a valid date time?
   bool validDateTime() const { return validDate() && validTime(); }
 
@@ -146,6 +158,11 @@ private:
     if (!validDateTime())
       return NA_REAL;
 
+    if (pZone_ != NULL) {
+      double local = utcdate() * 86400.0 + sec_ + (min_ * 60) + (hour_ * 3600);
+      return pZone_->toUTC(local, pCache_) + psec_ + offset_;
+    }
+
     struct Rtm tm;
     tm.tm_year = year_ - 1900;
     tm.tm_mon = mon_;
@@ -0,0 +1,158 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "DateTimeFormat.h"
+
+#include <cctype>
+
+static void addStep(DateTimeFormat* pOut, DateTimeStepType type, char c = 0) {
+  DateTimeStep step = {type, c, -1};
+  pOut->push_back(step);
+}
+
+static void compileSteps(const std::string& format, DateTimeFormat* pOut);
+
+// Steps of a compound format, which continue after the format if they fail
+static void compileCompound(const std::string& format, DateTimeFormat* pOut) {
+  size_t begin = pOut->size();
+  compileSteps(format, pOut);
+
+  int end = pOut->size();
+  for (size_t i = begin; i < pOut->size(); ++i) {
+    if ((*pOut)[i].next == -1)
+      (*pOut)[i].next = end;
+  }
+}
+
+static void compileSteps(const std::string& format, DateTimeFormat* pOut) {
+  addStep(pOut, STEP_WHITESPACE); // always consume leading whitespace
+
+  std::string::const_iterator formatItr, formatEnd = format.end();
+  for (formatItr = format.begin(); formatItr != formatEnd; ++formatItr) {
+    // Whitespace in format matches 0 or more whitespace in date
+    if (std::isspace(*formatItr)) {
+      addStep(pOut, STEP_WHITESPACE);
+      continue;
+    }
+
+    // Any other characters must much exactly.
+    if (*formatItr != '%') {
+      addStep(pOut, STEP_CHAR, *formatItr);
+      continue;
+    }
+
+    if (formatItr + 1 == formatEnd)
+      Rcpp::stop("Invalid format: trailing %");
+    formatItr++;
+
+    switch (*formatItr) {
+    case 'Y':
+      addStep(pOut, STEP_YEAR);
+      break;
+    case 'y':
+      addStep(pOut, STEP_YEAR2);
+      break;
+    case 'm':
+      addStep(pOut, STEP_MONTH);
+      break;
+    case 'b':
+      addStep(pOut, STEP_MONTH_ABB);
+      break;
+    case 'B':
+      addStep(pOut, STEP_MONTH_NAME);
+      break;
+    case 'd':
+      addStep(pOut, STEP_DAY);
+      break;
+    case 'a':
+      addStep(pOut, STEP_WEEKDAY_ABB);
+      break;
+    case 'e':
+      addStep(pOut, STEP_DAY_SPACE);
+      break;
+    case 'H':
+      addStep(pOut, STEP_HOUR);
+      break;
+    case 'I':
+      addStep(pOut, STEP_HOUR12);
+      break;
+    case 'M':
+      addStep(pOut, STEP_MINUTE);
+      break;
+    case 'S':
+      addStep(pOut, STEP_SECONDS);
+      break;
+    case 'O':
+      if (formatItr + 1 == formatEnd || *(formatItr + 1) != 'S')
+        Rcpp::stop("Invalid format: %%O must be followed by %%S");
+      formatItr++;
+      addStep(pOut, STEP_SECONDS_FRAC);
+      break;
+    case 'p':
+      addStep(pOut, STEP_AM_PM);
+      break;
+    case 'z':
+      addStep(pOut, STEP_TZ_OFFSET);
+      break;
+    case 'Z':
+      addStep(pOut, STEP_TZ_NAME);
+      break;
+
+    // Extensions
+    case '.':
+      addStep(pOut, STEP_NON_DIGIT);
+      break;
+    case '+':
+      addStep(pOut, STEP_NON_DIGITS);
+      break;
+    case '*':
+      addStep(pOut, STEP_ANY_NON_DIGIT);
+      break;
+
+    case 'A': // auto date / time
+      if (formatItr + 1 == formatEnd)
+        Rcpp::stop("Invalid format: %%A must be followed by another letter");
+      formatItr++;
+      switch (*formatItr) {
+      case 'D':
+        addStep(pOut, STEP_AUTO_DATE);
+        break;
+      case 'T':
+        addStep(pOut, STEP_AUTO_TIME);
+        break;
+      default:
+        Rcpp::stop("Invalid %%A auto parser");
+      }
+      break;
+
+    // Compound formats
+    case 'D':
+      compileCompound("%m/%d/%y", pOut);
+      break;
+    case 'F':
+      compileCompound("%Y-%m-%d", pOut);
+      break;
+    case 'R':
+      compileCompound("%H:%M", pOut);
+      break;
+    case 'X':
+    case 'T':
+      compileCompound("%H:%M:%S", pOut);
+      break;
+    case 'x':
+      compileCompound("%y/%m/%d", pOut);
+      break;
+
+    default:
+      Rcpp::stop("Unsupported format %%%s", *formatItr);
+    }
+  }
+
+  addStep(pOut, STEP_WHITESPACE); // always consume trailing whitespace
+}
+
+DateTimeFormat compileDateTimeFormat(const std::string& format) {
+  DateTimeFormat out;
+  compileSteps(format, &out);
+  return out;
+}
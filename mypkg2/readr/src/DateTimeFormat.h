@@ -0,0 +1,51 @@
+#ifndef FASTREAD_DATETIMEFORMAT_H_
+#define FASTREAD_DATETIMEFORMAT_H_
+
+#include <string>
+#include <vector>
+
+enum DateTimeStepType {
+  STEP_WHITESPACE,    // zero or more whitespace characters
+  STEP_CHAR,          // exactly the character of the step
+  STEP_YEAR,          // %Y
+  STEP_YEAR2,         // %y
+  STEP_MONTH,         // %m
+  STEP_MONTH_ABB,     // %b
+  STEP_MONTH_NAME,    // %B
+  STEP_DAY,           // %d
+  STEP_WEEKDAY_ABB,   // %a
+  STEP_DAY_SPACE,     // %e
+  STEP_HOUR,          // %H
+  STEP_HOUR12,        // %I
+  STEP_MINUTE,        // %M
+  STEP_SECONDS,       // %S
+  STEP_SECONDS_FRAC,  // %OS
+  STEP_AM_PM,         // %p
+  STEP_TZ_OFFSET,     // %z
+  STEP_TZ_NAME,       // %Z
+  STEP_NON_DIGIT,     // %.
+  STEP_NON_DIGITS,    // %+
+  STEP_ANY_NON_DIGIT, // %*
+  STEP_AUTO_DATE,     // %AD
+  STEP_AUTO_TIME      // %AT
+};
+
+struct DateTimeStep {
+  DateTimeStepType type;
+  char c;
+
+  // The step to continue from if this one fails, or -1 if the whole parse
+  // fails
+  int next;
+};
+
+// A format like "%Y-%m-%d", compiled once into the steps that parse it so
+// that the format isn't read again for every value. Compound formats such as
+// %D are expanded in place, and like the nested parse they used to run, a
+// failure inside one skips the rest of it rather than failing the parse.
+typedef std::vector<DateTimeStep> DateTimeFormat;
+
+// Throws an error if format is invalid
+DateTimeFormat compileDateTimeFormat(const std::string& format);
+
+#endif
@@ -2,8 +2,11 @@
 #define FASTREAD_DATE_TIME_PARSER_H_
 
 #include "DateTime.h"
+#include "DateTimeFormat.h"
+#include "DoubleParser.h"
+#include "IntegerParser.h"
+#include "Iso8601.h"
 #include "LocaleInfo.h"
-#include "QiParsers.h"
 #include "boost.h"
 #include <ctime>
 
@@ -20,6 +23,12 @@ class DateTimeParser {
 
   LocaleInfo* pLocale_;
   std::string tzDefault_;
+  bool utf8_;
+
+  // The zone of the locale, and the zone last named by %Z if it's another
+  // one. Each parser has its own caches, so parsers can run concurrently.
+  TimeZonePtr zoneDefault_, zoneNamed_;
+  TimeZone::Cache cacheDefault_, cacheNamed_;
 
   const char* dateItr_;
   const char* dateEnd_;
@@ -28,8 +37,11 @@ public:
   DateTimeParser(LocaleInfo* pLocale)
       : pLocale_(pLocale),
         tzDefault_(pLocale->tz_),
+        utf8_(pLocale->encoding_ == "UTF-8"),
         dateItr_(NULL),
         dateEnd_(NULL) {
+    if (tzDefault_ != "UTC")
+      zoneDefault_ = pLocale->timeZone();
     reset();
   }
 
@@ -37,6 +49,9 @@ public:
   // parsing with a format string so it doesn't seem necessary to add individual
   // parsers for other common formats.
   bool parseISO8601(bool partial = true) {
+    if (consumeISO8601Fixed())
+      return true;
+
     // Date: YYYY-MM-DD, YYYYMMDD
     if (!consumeInteger(4, &year_))
       return false;
@@ -79,9 +94,9 @@ public:
     return isComplete();
   }
 
-  bool parseLocaleTime() { return parse(pLocale_->timeFormat_); }
+  bool parseLocaleTime() { return parse(pLocale_->compiledTimeFormat()); }
 
-  bool parseLocaleDate() { return parse(pLocale_->dateFormat_); }
+  bool parseLocaleDate() { return parse(pLocale_->compiledDateFormat()); }
 
   // A flexible time parser for the most common formats
   bool parseTime() {
@@ -95,7 +110,7 @@ public:
     consumeSeconds(&sec_, NULL);
 
     consumeWhiteSpace();
-    consumeString(pLocale_->amPm_, &amPm_);
+    consumeName(pLocale_->amPmNames_, &amPm_);
     consumeWhiteSpace();
 
     return isComplete();
@@ -119,176 +134,42 @@ public:
 
   bool isComplete() { return dateItr_ == dateEnd_; }
 
-  void setDate(const char* date) {
+  void setDate(const char* begin, const char* end) {
     reset();
-    dateItr_ = date;
-    dateEnd_ = date + strlen(date);
+    dateItr_ = begin;
+    dateEnd_ = end;
   }
 
-  bool parse(const std::string& format) {
-    consumeWhiteSpace(); // always consume leading whitespace
-
-    std::string::const_iterator formatItr, formatEnd = format.end();
-    for (formatItr = format.begin(); formatItr != formatEnd; ++formatItr) {
-      // Whitespace in format matches 0 or more whitespace in date
-      if (std::isspace(*formatItr)) {
-        consumeWhiteSpace();
-        continue;
-      }
-
-      // Any other characters must much exactly.
-      if (*formatItr != '%') {
-        if (!consumeThisChar(*formatItr))
-          return false;
-        continue;
-      }
-
-      if (formatItr + 1 == formatEnd)
-        Rcpp::stop("Invalid format: trailing %");
-      formatItr++;
-
-      switch (*formatItr) {
-      case 'Y': // year with century
-        if (!consumeInteger(4, &year_))
-          return false;
-        break;
-      case 'y': // year without century
-        if (!consumeInteger(2, &year_))
-          return false;
-        year_ += (year_ < 69) ? 2000 : 1900;
-        break;
-      case 'm': // month
-        if (!consumeInteger1(2, &mon_, false))
-          return false;
-        break;
-      case 'b': // abbreviated month name
-        if (!consumeString(pLocale_->monAb_, &mon_))
-          return false;
-        break;
-      case 'B': // month name
-        if (!consumeString(pLocale_->mon_, &mon_))
-          return false;
-        break;
-      case 'd': // day
-        if (!consumeInteger1(2, &day_, false))
-          return false;
-        break;
-      case 'a': // abbreviated day of week
-        if (!consumeString(pLocale_->dayAb_, &day_))
-          return false;
-        break;
-      case 'e': // day with optional leading space
-        if (!consumeInteger1WithSpace(2, &day_))
-          return false;
-        break;
-      case 'H': // hour
-        if (!consumeInteger(2, &hour_, false))
-          return false;
-        break;
-      case 'I': // hour
-        if (!consumeInteger(2, &hour_, false))
-          return false;
-        if (hour_ < 1 || hour_ > 12) {
-          return false;
-        }
-        hour_ %= 12;
-        break;
-      case 'M': // minute
-        if (!consumeInteger(2, &min_))
-          return false;
-        break;
-      case 'S': // seconds (integer)
-        if (!consumeSeconds(&sec_, NULL))
-          return false;
-        break;
-      case 'O': // seconds (double)
-        if (formatItr + 1 == formatEnd || *(formatItr + 1) != 'S')
-          Rcpp::stop("Invalid format: %%O must be followed by %%S");
-        formatItr++;
-        if (!consumeSeconds(&sec_, &psec_))
-          return false;
-        break;
-
-      case 'p': // AM/PM
-        if (!consumeString(pLocale_->amPm_, &amPm_))
-          return false;
-        break;
-
-      case 'z': // time zone specification
-        tz_ = "UTC";
-        if (!consumeTzOffset(&tzOffsetHours_, &tzOffsetMinutes_))
-          return false;
-        break;
-      case 'Z': // time zone name
-        if (!consumeTzName(&tz_))
-          return false;
-        break;
-
-      // Extensions
-      case '.':
-        if (!consumeNonDigit())
-          return false;
-        break;
-
-      case '+':
-        if (!consumeNonDigits())
-          return false;
-        break;
-
-      case '*':
-        consumeNonDigits();
-        break;
-
-      case 'A': // auto date / time
-        if (formatItr + 1 == formatEnd)
-          Rcpp::stop("Invalid format: %%A must be followed by another letter");
-        formatItr++;
-        switch (*formatItr) {
-        case 'D':
-          if (!parseDate())
-            return false;
-          break;
-        case 'T':
-          if (!parseTime())
-            return false;
-          break;
-        default:
-          Rcpp::stop("Invalid %%A auto parser");
-        }
-        break;
-
-      // Compound formats
-      case 'D':
-        parse("%m/%d/%y");
-        break;
-      case 'F':
-        parse("%Y-%m-%d");
-        break;
-      case 'R':
-        parse("%H:%M");
-        break;
-      case 'X':
-      case 'T':
-        parse("%H:%M:%S");
-        break;
-      case 'x':
-        parse("%y/%m/%d");
-        break;
-
-      default:
-        Rcpp::stop("Unsupported format %%%s", *formatItr);
+  // Parses the date with a format from compileDateTimeFormat()
+  bool parse(const DateTimeFormat& format) {
+    size_t i = 0;
+    while (i < format.size()) {
+      const DateTimeStep& step = format[i];
+      if (consumeStep(step)) {
+        ++i;
+      } else if (step.next != -1) {
+        i = step.next;
+      } else {
+        return false;
       }
     }
 
-    consumeWhiteSpace(); // always consume trailing whitespace
-
     return isComplete();
   }
 
   DateTime makeDateTime() {
     DateTime dt(year_, mon_, day_, hour(), min_, sec_, psec_, tz_);
-    if (tz_ == "UTC")
+    if (tz_ == "UTC") {
       dt.setOffset(-tzOffsetHours_ * 3600 - tzOffsetMinutes_ * 60);
+    } else if (tz_ == tzDefault_) {
+      dt.setTimeZone(zoneDefault_.get(), &cacheDefault_);
+    } else {
+      if (!zoneNamed_ || zoneNamed_->name() != tz_) {
+        zoneNamed_ = TimeZonePtr(new TimeZone(tz_));
+        cacheNamed_ = TimeZone::Cache();
+      }
+      dt.setTimeZone(zoneNamed_.get(), &cacheNamed_);
+    }
 
     return dt;
   }
@@ -327,6 +208,130 @@ private:
     return hour_;
   }
 
+  // The common layouts YYYY-MM-DD and YYYY-MM-DD[T ]HH:MM:SS[.sss][Z], with
+  // up to nine digits of fractional seconds, which are read the same way as
+  // parseISO8601() reads them but much faster. Fails without consuming
+  // anything if the date has any other layout.
+  inline bool consumeISO8601Fixed() {
+    static const double pow10[10] = {
+        1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+    size_t n = dateEnd_ - dateItr_;
+    if (n != 10 && (n < 19 || n > 30))
+      return false;
+    int len = n == 10 ? 10 : 19;
+
+    // Everything after the seconds: a fraction, then an optional Z
+    const char* cur = dateItr_ + len;
+    int fraction = 0, digits = 0;
+    bool utc = false;
+    if (cur != dateEnd_ && *cur == pLocale_->decimalMark_) {
+      for (++cur; cur != dateEnd_ && *cur >= '0' && *cur <= '9'; ++cur) {
+        fraction = fraction * 10 + (*cur - '0');
+        if (++digits > 9)
+          return false;
+      }
+      if (digits == 0)
+        return false;
+    }
+    if (cur != dateEnd_ && *cur == 'Z') {
+      utc = true;
+      ++cur;
+    }
+    if (cur != dateEnd_)
+      return false;
+
+    char buffer[32] = {0};
+    memcpy(buffer, dateItr_, len);
+    if (!isIso8601Layout(buffer, len))
+      return false;
+
+    Iso8601Fields fields;
+    parseIso8601Fields(buffer, len, &fields);
+    year_ = fields.year;
+    mon_ = fields.mon - 1;
+    day_ = fields.day - 1;
+    hour_ = fields.hour;
+    min_ = fields.min;
+    sec_ = fields.sec;
+    compactDate_ = false;
+
+    // Like parseDouble(), which gives the correctly rounded value
+    if (digits > 0) {
+      double sec = (sec_ * pow10[digits] + fraction) / pow10[digits];
+      sec_ = (int)sec;
+      psec_ = sec - sec_;
+    }
+    if (utc)
+      tz_ = "UTC";
+
+    dateItr_ = dateEnd_;
+    return true;
+  }
+
+  inline bool consumeStep(const DateTimeStep& step) {
+    switch (step.type) {
+    case STEP_WHITESPACE:
+      return consumeWhiteSpace();
+    case STEP_CHAR:
+      return consumeThisChar(step.c);
+    case STEP_YEAR:
+      return consumeInteger(4, &year_);
+    case STEP_YEAR2:
+      if (!consumeInteger(2, &year_))
+        return false;
+      year_ += (year_ < 69) ? 2000 : 1900;
+      return true;
+    case STEP_MONTH:
+      return consumeInteger1(2, &mon_, false);
+    case STEP_MONTH_ABB:
+      return consumeName(pLocale_->monAbNames_, &mon_);
+    case STEP_MONTH_NAME:
+      return consumeName(pLocale_->monNames_, &mon_);
+    case STEP_DAY:
+      return consumeInteger1(2, &day_, false);
+    case STEP_WEEKDAY_ABB:
+      return consumeName(pLocale_->dayAbNames_, &day_);
+    case STEP_DAY_SPACE:
+      return consumeInteger1WithSpace(2, &day_);
+    case STEP_HOUR:
+      return consumeInteger(2, &hour_, false);
+    case STEP_HOUR12:
+      if (!consumeInteger(2, &hour_, false))
+        return false;
+      if (hour_ < 1 || hour_ > 12)
+        return false;
+      hour_ %= 12;
+      return true;
+    case STEP_MINUTE:
+      return consumeInteger(2, &min_);
+    case STEP_SECONDS:
+      return consumeSeconds(&sec_, NULL);
+    case STEP_SECONDS_FRAC:
+      return consumeSeconds(&sec_, &psec_);
+    case STEP_AM_PM:
+      return consumeName(pLocale_->amPmNames_, &amPm_);
+    case STEP_TZ_OFFSET:
+      tz_ = "UTC";
+      return consumeTzOffset(&tzOffsetHours_, &tzOffsetMinutes_);
+    case STEP_TZ_NAME:
+      return consumeTzName(&tz_);
+    case STEP_NON_DIGIT:
+      return consumeNonDigit();
+    case STEP_NON_DIGITS:
+      return consumeNonDigits();
+    case STEP_ANY_NON_DIGIT:
+      consumeNonDigits();
+      return true;
+    case STEP_AUTO_DATE:
+      return parseDate();
+    case STEP_AUTO_TIME:
+      return parseTime();
+    }
+
+    return false;
+  }
+
   inline bool consumeSeconds(int* pSec, double* pPartialSec) {
     double sec;
     if (!consumeDouble(&sec))
@@ -338,20 +343,21 @@ private:
     return true;
   }
 
-  inline bool
-  consumeString(const std::vector<std::string>& haystack, int* pOut) {
-    // haystack is always in UTF-8
-    std::string needleUTF8 = pLocale_->encoder_.makeString(dateItr_, dateEnd_);
-
-    for (size_t i = 0; i < haystack.size(); ++i) {
-      if (boost::istarts_with(needleUTF8, haystack[i])) {
-        *pOut = i;
-        dateItr_ += haystack[i].size();
-        return true;
-      }
+  inline bool consumeName(const NameTrie& names, int* pOut) {
+    // names are always in UTF-8
+    int i, length;
+    if (utf8_) {
+      i = names.match(dateItr_, dateEnd_, &length);
+    } else {
+      std::string date = pLocale_->encoder_.makeString(dateItr_, dateEnd_);
+      i = names.match(date.data(), date.data() + date.size(), &length);
     }
+    if (i == -1)
+      return false;
 
-    return false;
+    *pOut = i;
+    dateItr_ += length;
+    return true;
   }
 
   inline bool consumeInteger(int n, int* pOut, bool exact = true) {
@@ -458,7 +464,7 @@ private:
 
     // Optional +/- (required for ISO8601 but we'll let it slide)
     int mult = 1;
-    if (*dateItr_ == '+' || *dateItr_ == '-') {
+    if (dateItr_ != dateEnd_ && (*dateItr_ == '+' || *dateItr_ == '-')) {
       mult = (*dateItr_ == '-') ? -1 : 1;
       dateItr_++;
     }
@@ -0,0 +1,114 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "DictionaryVector.h"
+#include "altrep.h"
+
+// The string of code, looked up in dictionary
+static SEXP dictionaryElt(SEXP codes, SEXP dictionary, R_xlen_t i) {
+  int code = INTEGER(codes)[i];
+  return code == NA_INTEGER ? NA_STRING : STRING_ELT(dictionary, code);
+}
+
+static SEXP materialize(SEXP codes, SEXP dictionary) {
+  R_xlen_t n = XLENGTH(codes);
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, n));
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(out, i, dictionaryElt(codes, dictionary, i));
+  }
+  UNPROTECT(1);
+  return out;
+}
+
+#if defined(HAS_ALTREP)
+
+static R_altrep_class_t dictionary_string;
+
+// data1 is list(codes, dictionary) until the vector is materialized, when it
+// is released and data2 holds the strings
+static SEXP codes(SEXP x) { return VECTOR_ELT(R_altrep_data1(x), 0); }
+static SEXP dictionary(SEXP x) { return VECTOR_ELT(R_altrep_data1(x), 1); }
+static bool isMaterialized(SEXP x) { return R_altrep_data2(x) != R_NilValue; }
+
+static SEXP materialized(SEXP x) {
+  if (!isMaterialized(x)) {
+    R_set_altrep_data2(x, materialize(codes(x), dictionary(x)));
+    R_set_altrep_data1(x, R_NilValue);
+  }
+  return R_altrep_data2(x);
+}
+
+static R_xlen_t dictionary_Length(SEXP x) {
+  return XLENGTH(isMaterialized(x) ? R_altrep_data2(x) : codes(x));
+}
+
+static Rboolean dictionary_Inspect(
+    SEXP x,
+    int pre,
+    int deep,
+    int pvec,
+    void (*inspect_subtree)(SEXP, int, int, int)) {
+  if (isMaterialized(x)) {
+    Rprintf(
+        "readr dictionary vector (materialized, len=%d)\n",
+        (int)dictionary_Length(x));
+  } else {
+    Rprintf(
+        "readr dictionary vector (len=%d, dictionary=%d)\n",
+        (int)dictionary_Length(x),
+        (int)XLENGTH(dictionary(x)));
+  }
+  return TRUE;
+}
+
+static void* dictionary_Dataptr(SEXP x, Rboolean writeable) {
+  return DATAPTR(materialized(x));
+}
+
+static const void* dictionary_Dataptr_or_null(SEXP x) {
+  return isMaterialized(x) ? DATAPTR(R_altrep_data2(x)) : NULL;
+}
+
+static SEXP dictionary_Elt(SEXP x, R_xlen_t i) {
+  if (isMaterialized(x))
+    return STRING_ELT(R_altrep_data2(x), i);
+  return dictionaryElt(codes(x), dictionary(x), i);
+}
+
+static void dictionary_Set_elt(SEXP x, R_xlen_t i, SEXP value) {
+  SET_STRING_ELT(materialized(x), i, value);
+}
+
+// [[Rcpp::init]]
+void init_dictionary_vector(DllInfo* dll) {
+  dictionary_string =
+      R_make_altstring_class("dictionary_string", "readr", dll);
+
+  R_set_altrep_Length_method(dictionary_string, dictionary_Length);
+  R_set_altrep_Inspect_method(dictionary_string, dictionary_Inspect);
+  R_set_altvec_Dataptr_method(dictionary_string, dictionary_Dataptr);
+  R_set_altvec_Dataptr_or_null_method(
+      dictionary_string, dictionary_Dataptr_or_null);
+  R_set_altstring_Elt_method(dictionary_string, dictionary_Elt);
+  R_set_altstring_Set_elt_method(dictionary_string, dictionary_Set_elt);
+}
+
+SEXP makeDictionaryVector(SEXP codes, SEXP dictionary) {
+  SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(data1, 0, codes);
+  SET_VECTOR_ELT(data1, 1, dictionary);
+  SEXP out = R_new_altrep(dictionary_string, data1, R_NilValue);
+  UNPROTECT(1);
+  return out;
+}
+
+#else
+
+// [[Rcpp::init]]
+void init_dictionary_vector(DllInfo* dll) {}
+
+SEXP makeDictionaryVector(SEXP codes, SEXP dictionary) {
+  return materialize(codes, dictionary);
+}
+
+#endif
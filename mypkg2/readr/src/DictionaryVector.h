@@ -0,0 +1,13 @@
+#ifndef FASTREAD_DICTIONARYVECTOR_H_
+#define FASTREAD_DICTIONARYVECTOR_H_
+
+#include <Rcpp.h>
+
+// A character vector stored as zero-based codes into a dictionary of
+// strings, with NA_INTEGER for missing values. In R 3.5.0 and later it is an
+// ALTREP vector that looks each element up when it is used, and only creates
+// the full vector of strings if R needs a pointer to its data. In earlier
+// versions the strings are created straight away.
+SEXP makeDictionaryVector(SEXP codes, SEXP dictionary);
+
+#endif
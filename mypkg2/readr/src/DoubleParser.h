@@ -0,0 +1,12 @@
+#ifndef FASTREAD_DOUBLEPARSER_H_
+#define FASTREAD_DOUBLEPARSER_H_
+
+// Parses a number from the start of the range, like strtod() but with
+// decimalMark as the decimal separator and without skipping white space.
+// "nan", "inf" and "infinity" are accepted in any case, after an optional
+// sign. On success the correctly rounded value is stored in res and first is
+// moved past the number; on failure neither is changed.
+bool parseDouble(
+    char decimalMark, const char*& first, const char* last, double& res);
+
+#endif
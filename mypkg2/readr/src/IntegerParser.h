@@ -0,0 +1,79 @@
+#ifndef FASTREAD_INTEGERPARSER_H_
+#define FASTREAD_INTEGERPARSER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Digits are checked and converted eight at a time, as the bytes of a 64 bit
+// word (SWAR), in the way described in "Number Parsing at a Gigabyte per
+// Second" (Lemire, 2021).
+
+// The eight bytes at p, with the first in the lowest byte
+inline uint64_t loadEightBytes(const char* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+// Whether all eight bytes are ASCII digits
+inline bool isEightDigits(uint64_t x) {
+  return ((x & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
+
+// The value of eight ASCII digits, most significant first
+inline uint32_t parseEightDigits(uint64_t x) {
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+  x -= 0x3030303030303030ULL;
+  x = (x * 10) + (x >> 8);
+  x = (((x & mask) * mul1) + (((x >> 16) & mask) * mul2)) >> 32;
+  return (uint32_t)x;
+}
+
+// Parses an integer with an optional sign from the start of the range. On
+// success the value is stored in res and first is moved past the number.
+// Values outside the range of an R integer fail, including INT_MIN, which R
+// uses for NA; on failure neither res nor first is changed.
+inline bool parseInt(const char*& first, const char* last, int& res) {
+  const char* cur = first;
+
+  bool negative = false;
+  if (cur != last && (*cur == '-' || *cur == '+')) {
+    negative = *cur == '-';
+    ++cur;
+  }
+
+  // The value is checked after every step, so it never needs more than
+  // 31 + 27 bits
+  const uint64_t max = 2147483647;
+  const char* digits = cur;
+  uint64_t value = 0;
+  while (last - cur >= 8) {
+    uint64_t x = loadEightBytes(cur);
+    if (!isEightDigits(x))
+      break;
+    value = value * 100000000 + parseEightDigits(x);
+    if (value > max)
+      return false;
+    cur += 8;
+  }
+  for (; cur != last && *cur >= '0' && *cur <= '9'; ++cur) {
+    value = value * 10 + (*cur - '0');
+    if (value > max)
+      return false;
+  }
+  if (cur == digits)
+    return false;
+
+  res = negative ? -(int)value : (int)value;
+  first = cur;
+  return true;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef FASTREAD_ISO8601_H_
+#define FASTREAD_ISO8601_H_
+
+#include "IntegerParser.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Fields of the fixed layout YYYY-MM-DDTHH:MM:SS (or its first ten bytes),
+// which most date times are written in. The layout is checked with one SIMD
+// comparison of its bytes, and the fields are converted eight digits at a
+// time, so that the general ISO8601 parser is only needed for the others.
+struct Iso8601Fields {
+  int year, mon, day, hour, min, sec;
+};
+
+// Bits of the positions of the digits and of the separators in the layout
+static const uint32_t iso8601Digits = 0x6db6f, iso8601Separators = 0x12490;
+
+// Checks the first len bytes (10 or 19) of p, which must hold 32 bytes,
+// against the layout. A space may separate the date and the time.
+inline bool isIso8601Layout(const char* p, int len) {
+  static const char layout[32] = "0000-00-00T00:00:00";
+
+  uint32_t digits = 0, same = 0;
+#if defined(__AVX2__)
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layout));
+  __m256i d = _mm256_subs_epu8(
+      _mm256_sub_epi8(v, _mm256_set1_epi8('0')), _mm256_set1_epi8(9));
+  digits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(d, _mm256_setzero_si256()));
+  same = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, l));
+#elif defined(__SSE2__)
+  for (int i = 0; i < 32; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layout + i));
+    __m128i d = _mm_subs_epu8(
+        _mm_sub_epi8(v, _mm_set1_epi8('0')), _mm_set1_epi8(9));
+    digits |= (uint32_t)_mm_movemask_epi8(
+                  _mm_cmpeq_epi8(d, _mm_setzero_si128()))
+              << i;
+    same |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, l)) << i;
+  }
+#else
+  for (int i = 0; i < len; ++i) {
+    digits |= (uint32_t)(p[i] >= '0' && p[i] <= '9') << i;
+    same |= (uint32_t)(p[i] == layout[i]) << i;
+  }
+#endif
+  if (len > 10 && p[10] == ' ')
+    same |= 1 << 10;
+
+  uint32_t used = (1u << len) - 1;
+  return (digits & iso8601Digits & used) == (iso8601Digits & used) &&
+         (same & iso8601Separators & used) == (iso8601Separators & used);
+}
+
+// Converts the fields of p, which must have passed isIso8601Layout()
+inline void parseIso8601Fields(const char* p, int len, Iso8601Fields* pOut) {
+  char date[8] = {p[0], p[1], p[2], p[3], p[5], p[6], p[8], p[9]};
+  uint32_t ymd = parseEightDigits(loadEightBytes(date));
+  pOut->year = ymd / 10000;
+  pOut->mon = ymd / 100 % 100;
+  pOut->day = ymd % 100;
+
+  if (len == 10) {
+    pOut->hour = pOut->min = pOut->sec = 0;
+    return;
+  }
+
+  char time[8] = {p[11], p[12], p[14], p[15], p[17], p[18], '0', '0'};
+  uint32_t hms = parseEightDigits(loadEightBytes(time)) / 100;
+  pOut->hour = hms / 10000;
+  pOut->min = hms / 100 % 100;
+  pOut->sec = hms % 100;
+}
+
+#endif
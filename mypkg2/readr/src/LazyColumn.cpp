@@ -0,0 +1,188 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "LazyColumn.h"
+#include "altrep.h"
+
+#include <algorithm>
+#include <string.h>
+
+LazyColumn::LazyColumn(
+    SourcePtr source,
+    TokenizerPtr tokenizer,
+    LocaleInfoPtr pLocale,
+    CollectorPtr collector,
+    int col)
+    : source_(source),
+      tokenizer_(tokenizer),
+      pLocale_(pLocale),
+      collector_(collector),
+      fields_(col),
+      n_(0) {
+  warnings_.setMaxProblems(maxProblemsOption());
+}
+
+SEXP LazyColumn::prototype() { return collector_->vector(); }
+
+SEXP LazyColumn::convert() {
+  collector_->setWarnings(&warnings_);
+  collector_->resize(n_);
+
+  // Rows without a field are left as NA by resize()
+  fields_.convert(collector_.get(), n_);
+  RObject out = collector_->vector();
+
+  warnings_.copyInput();
+  fields_.clear();
+  collector_.reset();
+  pLocale_.reset();
+  tokenizer_.reset();
+  source_.reset();
+
+  return out;
+}
+
+#if defined(HAS_ALTREP)
+
+static R_altrep_class_t lazy_integer, lazy_real, lazy_logical, lazy_string;
+
+bool hasLazyVectors() { return true; }
+
+// data1 is an external pointer to the LazyColumnPtr until the column is
+// converted, when it is released and data2 holds the converted vector
+static LazyColumn* column(SEXP x) {
+  return static_cast<LazyColumnPtr*>(R_ExternalPtrAddr(R_altrep_data1(x)))
+      ->get();
+}
+static bool isConverted(SEXP x) { return R_altrep_data2(x) != R_NilValue; }
+
+static SEXP converted(SEXP x) {
+  if (isConverted(x))
+    return R_altrep_data2(x);
+
+  // C++ exceptions can't unwind through R, so errors are raised once the
+  // conversion has cleaned up
+  char error[8192];
+  bool failed = false;
+  int problems = 0;
+  try {
+    LazyColumn* pColumn = column(x);
+    R_set_altrep_data2(x, pColumn->convert());
+
+    problems = pColumn->warnings().total();
+    if (problems > 0) {
+      Rf_setAttrib(
+          x, Rf_install("problems"), pColumn->warnings().asDataFrame());
+    }
+    R_set_altrep_data1(x, R_NilValue);
+  } catch (std::exception& e) {
+    strncpy(error, e.what(), sizeof(error) - 1);
+    failed = true;
+  }
+
+  if (failed)
+    Rf_error("%s", error);
+  if (problems > 0) {
+    Rf_warning(
+        "%i parsing failure%s in a lazily read column, see problems()",
+        problems,
+        problems == 1 ? "" : "s");
+  }
+
+  return R_altrep_data2(x);
+}
+
+static R_xlen_t lazy_Length(SEXP x) {
+  return isConverted(x) ? XLENGTH(R_altrep_data2(x)) : column(x)->size();
+}
+
+static Rboolean lazy_Inspect(
+    SEXP x,
+    int pre,
+    int deep,
+    int pvec,
+    void (*inspect_subtree)(SEXP, int, int, int)) {
+  Rprintf(
+      "readr lazy column (len=%d, %s)\n",
+      (int)lazy_Length(x),
+      isConverted(x) ? "converted" : "not converted");
+  return TRUE;
+}
+
+static void* lazy_Dataptr(SEXP x, Rboolean writeable) {
+  return DATAPTR(converted(x));
+}
+
+static const void* lazy_Dataptr_or_null(SEXP x) {
+  return isConverted(x) ? DATAPTR(R_altrep_data2(x)) : NULL;
+}
+
+static SEXP lazy_string_Elt(SEXP x, R_xlen_t i) {
+  return STRING_ELT(converted(x), i);
+}
+
+static void lazy_string_Set_elt(SEXP x, R_xlen_t i, SEXP value) {
+  SET_STRING_ELT(converted(x), i, value);
+}
+
+static void initMethods(R_altrep_class_t cls) {
+  R_set_altrep_Length_method(cls, lazy_Length);
+  R_set_altrep_Inspect_method(cls, lazy_Inspect);
+  R_set_altvec_Dataptr_method(cls, lazy_Dataptr);
+  R_set_altvec_Dataptr_or_null_method(cls, lazy_Dataptr_or_null);
+}
+
+// [[Rcpp::init]]
+void init_lazy_column(DllInfo* dll) {
+  lazy_integer = R_make_altinteger_class("lazy_integer", "readr", dll);
+  lazy_real = R_make_altreal_class("lazy_real", "readr", dll);
+  lazy_logical = R_make_altlogical_class("lazy_logical", "readr", dll);
+  lazy_string = R_make_altstring_class("lazy_string", "readr", dll);
+
+  initMethods(lazy_integer);
+  initMethods(lazy_real);
+  initMethods(lazy_logical);
+  initMethods(lazy_string);
+  R_set_altstring_Elt_method(lazy_string, lazy_string_Elt);
+  R_set_altstring_Set_elt_method(lazy_string, lazy_string_Set_elt);
+}
+
+SEXP makeLazyVector(LazyColumnPtr column) {
+  RObject prototype = column->prototype();
+
+  R_altrep_class_t cls;
+  switch (TYPEOF(prototype)) {
+  case INTSXP:
+    cls = lazy_integer;
+    break;
+  case REALSXP:
+    cls = lazy_real;
+    break;
+  case LGLSXP:
+    cls = lazy_logical;
+    break;
+  case STRSXP:
+    cls = lazy_string;
+    break;
+  default:
+    Rcpp::stop(
+        "Columns of type %s can't be read lazily",
+        Rf_type2char(TYPEOF(prototype)));
+  }
+
+  XPtr<LazyColumnPtr> data1(new LazyColumnPtr(column), true);
+  RObject out = R_new_altrep(cls, data1, R_NilValue);
+  DUPLICATE_ATTRIB(out, prototype);
+  return out;
+}
+
+#else
+
+bool hasLazyVectors() { return false; }
+
+// [[Rcpp::init]]
+void init_lazy_column(DllInfo* dll) {}
+
+SEXP makeLazyVector(LazyColumnPtr column) { return column->convert(); }
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FASTREAD_LAZYCOLUMN_H_
+#define FASTREAD_LAZYCOLUMN_H_
+
+#include "Collector.h"
+#include "ColumnFields.h"
+#include "LocaleInfo.h"
+#include "Source.h"
+#include "TokenBatch.h"
+#include "Warnings.h"
+#include <Rcpp.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class LazyColumn;
+typedef boost::shared_ptr<LazyColumn> LazyColumnPtr;
+
+// The fields of one column, recorded while the file is read, so that they
+// can be converted by the column's collector when the column is first used.
+// Only the position, length and flags of each field are kept; the source,
+// the tokenizer (to unescape fields) and the locale used by the collector
+// are kept alive until then.
+class LazyColumn {
+  SourcePtr source_;
+  TokenizerPtr tokenizer_;
+  LocaleInfoPtr pLocale_;
+  CollectorPtr collector_;
+  ColumnFields fields_;
+
+  // Number of rows of the column
+  int n_;
+
+  Warnings warnings_;
+
+public:
+  LazyColumn(
+      SourcePtr source,
+      TokenizerPtr tokenizer,
+      LocaleInfoPtr pLocale,
+      CollectorPtr collector,
+      int col);
+
+  // Record the fields of the column in batch, whose rows are counted from
+  // offset
+  void append(const TokenBatch& batch, int offset) {
+    fields_.append(batch, offset);
+  }
+
+  int size() const { return n_; }
+  void resize(int n) { n_ = n; }
+
+  // Make room for the fields of n rows
+  void reserve(int n) { fields_.reserve(n); }
+
+  // The type and attributes of the converted column, as an empty vector
+  SEXP prototype();
+
+  // Runs the collector over the fields and releases them, along with the
+  // source and tokenizer. Problems are added to warnings().
+  SEXP convert();
+
+  Warnings& warnings() { return warnings_; }
+};
+
+// Whether lazy columns can be returned as ALTREP vectors
+bool hasLazyVectors();
+
+// An ALTREP vector that converts the column when R first needs its values
+SEXP makeLazyVector(LazyColumnPtr column);
+
+#endif
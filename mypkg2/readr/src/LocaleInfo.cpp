@@ -17,6 +17,11 @@ LocaleInfo::LocaleInfo(List x)
   dayAb_ = as<std::vector<std::string> >(date_names["day_ab"]);
   amPm_ = as<std::vector<std::string> >(date_names["am_pm"]);
 
+  monNames_ = NameTrie(mon_);
+  monAbNames_ = NameTrie(monAb_);
+  dayAbNames_ = NameTrie(dayAb_);
+  amPmNames_ = NameTrie(amPm_);
+
   decimalMark_ = as<char>(x["decimal_mark"]);
   groupingMark_ = as<char>(x["grouping_mark"]);
 
@@ -25,3 +30,21 @@ LocaleInfo::LocaleInfo(List x)
 
   tz_ = as<std::string>(x["tz"]);
 }
+
+TimeZonePtr LocaleInfo::timeZone() {
+  if (!timeZone_)
+    timeZone_ = TimeZonePtr(new TimeZone(tz_));
+  return timeZone_;
+}
+
+const DateTimeFormat& LocaleInfo::compiledDateFormat() {
+  if (compiledDateFormat_.empty())
+    compiledDateFormat_ = compileDateTimeFormat(dateFormat_);
+  return compiledDateFormat_;
+}
+
+const DateTimeFormat& LocaleInfo::compiledTimeFormat() {
+  if (compiledTimeFormat_.empty())
+    compiledTimeFormat_ = compileDateTimeFormat(timeFormat_);
+  return compiledTimeFormat_;
+}
@@ -1,7 +1,11 @@
 #ifndef FASTREAD_LOCALINFO
 #define FASTREAD_LOCALINFO
 
+#include "DateTimeFormat.h"
 #include "Iconv.h"
+#include "NameTrie.h"
+#include "TimeZone.h"
+#include <boost/shared_ptr.hpp>
 
 class LocaleInfo {
 
@@ -10,6 +14,9 @@ public:
   std::vector<std::string> mon_, monAb_, day_, dayAb_, amPm_;
   std::string dateFormat_, timeFormat_;
 
+  // The names above that are matched when dates are parsed
+  NameTrie monNames_, monAbNames_, dayAbNames_, amPmNames_;
+
   // LC_NUMERIC
   char decimalMark_, groupingMark_;
 
@@ -19,6 +26,19 @@ public:
   Iconv encoder_;
 
   LocaleInfo(Rcpp::List);
+
+  // The time zone named by tz_, loaded the first time it's needed
+  TimeZonePtr timeZone();
+
+  // dateFormat_ and timeFormat_, compiled the first time they're needed
+  const DateTimeFormat& compiledDateFormat();
+  const DateTimeFormat& compiledTimeFormat();
+
+private:
+  TimeZonePtr timeZone_;
+  DateTimeFormat compiledDateFormat_, compiledTimeFormat_;
 };
 
+typedef boost::shared_ptr<LocaleInfo> LocaleInfoPtr;
+
 #endif
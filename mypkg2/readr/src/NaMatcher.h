@@ -0,0 +1,88 @@
+#ifndef FASTREAD_NAMATCHER_H_
+#define FASTREAD_NAMATCHER_H_
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Matches fields against the strings that mean NA. Built once per tokenizer
+// (or per call of parse_vector_() and type_convert_col()) and then used for
+// every field. The strings are grouped by length, and a table records the
+// lengths of the strings starting with each byte, so most fields are
+// rejected by a single lookup, and the rest are only compared with the
+// strings of their own length.
+class NaMatcher {
+  // Strings at least this long are compared one by one
+  enum { MAX_LENGTH = 64 };
+
+  // Bit n of firsts_[c] is set if a string of length n starts with byte c
+  uint64_t firsts_[256];
+  bool empty_;
+
+  // The strings, ordered by length; those of length n < MAX_LENGTH are
+  // strings_[start_[n]] to strings_[start_[n + 1] - 1], and the longer ones
+  // follow from start_[MAX_LENGTH]
+  std::vector<std::string> strings_;
+  int start_[MAX_LENGTH + 1];
+
+  static bool shorter(const std::string& x, const std::string& y) {
+    return x.size() < y.size();
+  }
+
+public:
+  NaMatcher() : empty_(false) { init(); }
+
+  NaMatcher(const std::vector<std::string>& NA)
+      : empty_(false), strings_(NA) {
+    init();
+  }
+
+  // Whether the field from begin to end is one of the strings
+  bool matches(const char* begin, const char* end) const {
+    size_t n = end - begin;
+    if (n == 0)
+      return empty_;
+
+    if (n < MAX_LENGTH) {
+      if (((firsts_[(unsigned char)*begin] >> n) & 1) == 0)
+        return false;
+
+      for (int i = start_[n]; i < start_[n + 1]; ++i) {
+        if (memcmp(strings_[i].data(), begin, n) == 0)
+          return true;
+      }
+      return false;
+    }
+
+    for (size_t i = start_[MAX_LENGTH]; i < strings_.size(); ++i) {
+      if (strings_[i].size() == n && memcmp(strings_[i].data(), begin, n) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  // Whether the empty string is one of the strings
+  bool matchesEmpty() const { return empty_; }
+
+private:
+  void init() {
+    std::stable_sort(strings_.begin(), strings_.end(), shorter);
+    std::fill(firsts_, firsts_ + 256, 0);
+
+    size_t i = 0;
+    for (int n = 0; n <= MAX_LENGTH; ++n) {
+      start_[n] = i;
+      for (; i < strings_.size() && strings_[i].size() == (size_t)n; ++i) {
+        if (n == 0) {
+          empty_ = true;
+        } else if (n < MAX_LENGTH) {
+          firsts_[(unsigned char)strings_[i][0]] |= (uint64_t)1 << n;
+        }
+      }
+    }
+  }
+};
+
+#endif
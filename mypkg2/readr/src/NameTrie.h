@@ -0,0 +1,79 @@
+#ifndef FASTREAD_NAMETRIE_H_
+#define FASTREAD_NAMETRIE_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Matches the start of a string against a list of names, such as the month
+// names of a locale, by walking a trie of the names rather than comparing
+// each one in turn. Like boost::istarts_with(), ASCII letters match either
+// case. If several names match, the one that comes first in the list wins.
+class NameTrie {
+  struct Node {
+    int value; // index of the first name that ends here, or -1
+    std::vector<std::pair<char, int> > children;
+
+    Node() : value(-1) {}
+  };
+  std::vector<Node> nodes_;
+
+public:
+  NameTrie() : nodes_(1) {}
+
+  explicit NameTrie(const std::vector<std::string>& names) : nodes_(1) {
+    for (size_t i = 0; i < names.size(); ++i) {
+      int node = 0;
+      for (size_t k = 0; k < names[i].size(); ++k) {
+        node = child(node, fold(names[i][k]), true);
+      }
+      if (nodes_[node].value == -1)
+        nodes_[node].value = i;
+    }
+  }
+
+  // The index of the name that begins [begin, end), or -1 if none does.
+  // *pLength is set to the length of the name.
+  int match(const char* begin, const char* end, int* pLength) const {
+    int node = 0, best = nodes_[0].value;
+    *pLength = 0;
+    for (const char* cur = begin; cur != end; ++cur) {
+      node = child(node, fold(*cur));
+      if (node == -1)
+        break;
+
+      int value = nodes_[node].value;
+      if (value != -1 && (best == -1 || value < best)) {
+        best = value;
+        *pLength = cur - begin + 1;
+      }
+    }
+
+    return best;
+  }
+
+private:
+  static char fold(char c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+
+  int child(int node, char c) const {
+    const std::vector<std::pair<char, int> >& children = nodes_[node].children;
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (children[i].first == c)
+        return children[i].second;
+    }
+    return -1;
+  }
+
+  int child(int node, char c, bool add) {
+    int next = static_cast<const NameTrie*>(this)->child(node, c);
+    if (next != -1 || !add)
+      return next;
+
+    next = nodes_.size();
+    nodes_[node].children.push_back(std::make_pair(c, next));
+    nodes_.push_back(Node());
+    return next;
+  }
+};
+
+#endif
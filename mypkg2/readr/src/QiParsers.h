@@ -3,35 +3,6 @@
 
 #include "boost.h"
 
-struct DecimalCommaPolicy
-    : public boost::spirit::qi::real_policies<long double> {
-  template <typename Iterator>
-  static bool parse_dot(Iterator& first, Iterator const& last) {
-    if (first == last || *first != ',')
-      return false;
-    ++first;
-    return true;
-  }
-};
-
-template <typename Iterator, typename Attr>
-inline bool parseDouble(
-    const char decimalMark, Iterator& first, Iterator& last, Attr& res) {
-
-  if (decimalMark == '.') {
-    return boost::spirit::qi::parse(
-        first, last, boost::spirit::qi::long_double, res);
-  } else if (decimalMark == ',') {
-    return boost::spirit::qi::parse(
-        first,
-        last,
-        boost::spirit::qi::real_parser<long double, DecimalCommaPolicy>(),
-        res);
-  } else {
-    return false;
-  }
-}
-
 enum NumberState { STATE_INIT, STATE_LHS, STATE_RHS, STATE_EXP, STATE_FIN };
 
 // First and last are updated to point to first/last successfully parsed
@@ -146,9 +117,4 @@ end:
   return seenNumber;
 }
 
-template <typename Iterator, typename Attr>
-inline bool parseInt(Iterator& first, Iterator& last, Attr& res) {
-  return boost::spirit::qi::parse(first, last, boost::spirit::qi::int_, res);
-}
-
 #endif
@@ -0,0 +1,109 @@
+#ifndef FASTREAD_RAWSTRINGMAP_H_
+#define FASTREAD_RAWSTRINGMAP_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Maps byte strings, as they appear in the file, to integers. The keys are
+// copied into a single buffer and found with open addressing and linear
+// probing, so a lookup costs one hash of the bytes and usually a single
+// memcmp(), without allocating or creating a CHARSXP.
+class RawStringMap {
+  struct Slot {
+    uint64_t hash;
+    size_t offset; // position of the key in bytes_
+    size_t size;   // length of the key
+    int value;
+    bool used;
+
+    Slot() : hash(0), offset(0), size(0), value(0), used(false) {}
+  };
+
+  std::vector<Slot> slots_; // the size is always a power of two
+  std::string bytes_;
+  size_t n_;
+
+public:
+  RawStringMap() : slots_(16), n_(0) {}
+
+  size_t size() const { return n_; }
+
+  // Removes all keys and releases their storage
+  void clear() {
+    std::vector<Slot>(16).swap(slots_);
+    std::string().swap(bytes_);
+    n_ = 0;
+  }
+
+  // Finds the value of the key from begin to end. Returns false if the key
+  // has not been inserted.
+  bool find(const char* begin, const char* end, int* pValue) const {
+    uint64_t h = hash(begin, end);
+    const Slot& slot = slots_[probe(begin, end, h)];
+    if (!slot.used)
+      return false;
+
+    *pValue = slot.value;
+    return true;
+  }
+
+  // Adds a key that is not already in the map
+  void insert(const char* begin, const char* end, int value) {
+    // Keep the table at most half full, so probe sequences stay short
+    if (2 * (n_ + 1) > slots_.size())
+      grow();
+
+    uint64_t h = hash(begin, end);
+    Slot& slot = slots_[probe(begin, end, h)];
+    slot.hash = h;
+    slot.offset = bytes_.size();
+    slot.size = end - begin;
+    slot.value = value;
+    slot.used = true;
+    bytes_.append(begin, end);
+    ++n_;
+  }
+
+  // 64 bit FNV-1a
+  static uint64_t hash(const char* begin, const char* end) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const char* cur = begin; cur != end; ++cur) {
+      h ^= (unsigned char)*cur;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+private:
+  // The slot holding the key, or the empty slot where it would be inserted
+  size_t probe(const char* begin, const char* end, uint64_t h) const {
+    size_t mask = slots_.size() - 1, size = end - begin;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+      const Slot& slot = slots_[i];
+      if (!slot.used)
+        return i;
+      if (slot.hash == h && slot.size == size &&
+          (size == 0 || memcmp(&bytes_[slot.offset], begin, size) == 0))
+        return i;
+    }
+  }
+
+  void grow() {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+
+    size_t mask = slots_.size() - 1;
+    for (size_t k = 0; k < old.size(); ++k) {
+      if (!old[k].used)
+        continue;
+      size_t i = old[k].hash & mask;
+      while (slots_[i].used)
+        i = (i + 1) & mask;
+      slots_[i] = old[k];
+    }
+  }
+};
+
+#endif
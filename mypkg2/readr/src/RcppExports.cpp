@@ -84,6 +84,18 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// count_records_
+int count_records_(List sourceSpec, List tokenizerSpec);
+RcppExport SEXP _readr_count_records_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type sourceSpec(sourceSpecSEXP);
+    Rcpp::traits::input_parameter< List >::type tokenizerSpec(tokenizerSpecSEXP);
+    rcpp_result_gen = Rcpp::wrap(count_records_(sourceSpec, tokenizerSpec));
+    return rcpp_result_gen;
+END_RCPP
+}
 // guess_header_
 RObject guess_header_(List sourceSpec, List tokenizerSpec, List locale_);
 RcppExport SEXP _readr_guess_header_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP, SEXP locale_SEXP) {
@@ -205,8 +217,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // read_tokens_
-RObject read_tokens_(List sourceSpec, List tokenizerSpec, ListOf<List> colSpecs, CharacterVector colNames, List locale_, int n_max, bool progress);
-RcppExport SEXP _readr_read_tokens_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP, SEXP colSpecsSEXP, SEXP colNamesSEXP, SEXP locale_SEXP, SEXP n_maxSEXP, SEXP progressSEXP) {
+RObject read_tokens_(List sourceSpec, List tokenizerSpec, ListOf<List> colSpecs, CharacterVector colNames, List locale_, ListOf<List> filterSpecs, int n_max, bool progress, int num_threads, bool lazy, int promote);
+RcppExport SEXP _readr_read_tokens_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP, SEXP colSpecsSEXP, SEXP colNamesSEXP, SEXP locale_SEXP, SEXP filterSpecsSEXP, SEXP n_maxSEXP, SEXP progressSEXP, SEXP num_threadsSEXP, SEXP lazySEXP, SEXP promoteSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -215,15 +227,19 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< ListOf<List> >::type colSpecs(colSpecsSEXP);
     Rcpp::traits::input_parameter< CharacterVector >::type colNames(colNamesSEXP);
     Rcpp::traits::input_parameter< List >::type locale_(locale_SEXP);
+    Rcpp::traits::input_parameter< ListOf<List> >::type filterSpecs(filterSpecsSEXP);
     Rcpp::traits::input_parameter< int >::type n_max(n_maxSEXP);
     Rcpp::traits::input_parameter< bool >::type progress(progressSEXP);
-    rcpp_result_gen = Rcpp::wrap(read_tokens_(sourceSpec, tokenizerSpec, colSpecs, colNames, locale_, n_max, progress));
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type lazy(lazySEXP);
+    Rcpp::traits::input_parameter< int >::type promote(promoteSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_tokens_(sourceSpec, tokenizerSpec, colSpecs, colNames, locale_, filterSpecs, n_max, progress, num_threads, lazy, promote));
     return rcpp_result_gen;
 END_RCPP
 }
 // read_tokens_chunked_
-void read_tokens_chunked_(List sourceSpec, Environment callback, int chunkSize, List tokenizerSpec, ListOf<List> colSpecs, CharacterVector colNames, List locale_, bool progress);
-RcppExport SEXP _readr_read_tokens_chunked_(SEXP sourceSpecSEXP, SEXP callbackSEXP, SEXP chunkSizeSEXP, SEXP tokenizerSpecSEXP, SEXP colSpecsSEXP, SEXP colNamesSEXP, SEXP locale_SEXP, SEXP progressSEXP) {
+void read_tokens_chunked_(List sourceSpec, Environment callback, int chunkSize, List tokenizerSpec, ListOf<List> colSpecs, CharacterVector colNames, List locale_, ListOf<List> filterSpecs, bool progress, int num_threads);
+RcppExport SEXP _readr_read_tokens_chunked_(SEXP sourceSpecSEXP, SEXP callbackSEXP, SEXP chunkSizeSEXP, SEXP tokenizerSpecSEXP, SEXP colSpecsSEXP, SEXP colNamesSEXP, SEXP locale_SEXP, SEXP filterSpecsSEXP, SEXP progressSEXP, SEXP num_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< List >::type sourceSpec(sourceSpecSEXP);
@@ -233,14 +249,16 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< ListOf<List> >::type colSpecs(colSpecsSEXP);
     Rcpp::traits::input_parameter< CharacterVector >::type colNames(colNamesSEXP);
     Rcpp::traits::input_parameter< List >::type locale_(locale_SEXP);
+    Rcpp::traits::input_parameter< ListOf<List> >::type filterSpecs(filterSpecsSEXP);
     Rcpp::traits::input_parameter< bool >::type progress(progressSEXP);
-    read_tokens_chunked_(sourceSpec, callback, chunkSize, tokenizerSpec, colSpecs, colNames, locale_, progress);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    read_tokens_chunked_(sourceSpec, callback, chunkSize, tokenizerSpec, colSpecs, colNames, locale_, filterSpecs, progress, num_threads);
     return R_NilValue;
 END_RCPP
 }
 // guess_types_
-std::vector<std::string> guess_types_(List sourceSpec, List tokenizerSpec, Rcpp::List locale_, int n);
-RcppExport SEXP _readr_guess_types_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP, SEXP locale_SEXP, SEXP nSEXP) {
+std::vector<std::string> guess_types_(List sourceSpec, List tokenizerSpec, Rcpp::List locale_, int n, int samples, int num_threads);
+RcppExport SEXP _readr_guess_types_(SEXP sourceSpecSEXP, SEXP tokenizerSpecSEXP, SEXP locale_SEXP, SEXP nSEXP, SEXP samplesSEXP, SEXP num_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -248,7 +266,9 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< List >::type tokenizerSpec(tokenizerSpecSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type locale_(locale_SEXP);
     Rcpp::traits::input_parameter< int >::type n(nSEXP);
-    rcpp_result_gen = Rcpp::wrap(guess_types_(sourceSpec, tokenizerSpec, locale_, n));
+    Rcpp::traits::input_parameter< int >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(guess_types_(sourceSpec, tokenizerSpec, locale_, n, samples, num_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -340,6 +360,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_readr_utctime", (DL_FUNC) &_readr_utctime, 7},
     {"_readr_dim_tokens_", (DL_FUNC) &_readr_dim_tokens_, 2},
     {"_readr_count_fields_", (DL_FUNC) &_readr_count_fields_, 3},
+    {"_readr_count_records_", (DL_FUNC) &_readr_count_records_, 2},
     {"_readr_guess_header_", (DL_FUNC) &_readr_guess_header_, 3},
     {"_readr_tokenize_", (DL_FUNC) &_readr_tokenize_, 3},
     {"_readr_parse_vector_", (DL_FUNC) &_readr_parse_vector_, 5},
@@ -349,9 +370,9 @@ static const R_CallMethodDef CallEntries[] = {
     {"_readr_read_lines_chunked_", (DL_FUNC) &_readr_read_lines_chunked_, 6},
     {"_readr_read_lines_raw_", (DL_FUNC) &_readr_read_lines_raw_, 3},
     {"_readr_read_lines_raw_chunked_", (DL_FUNC) &_readr_read_lines_raw_chunked_, 4},
-    {"_readr_read_tokens_", (DL_FUNC) &_readr_read_tokens_, 7},
-    {"_readr_read_tokens_chunked_", (DL_FUNC) &_readr_read_tokens_chunked_, 8},
-    {"_readr_guess_types_", (DL_FUNC) &_readr_guess_types_, 4},
+    {"_readr_read_tokens_", (DL_FUNC) &_readr_read_tokens_, 11},
+    {"_readr_read_tokens_chunked_", (DL_FUNC) &_readr_read_tokens_chunked_, 10},
+    {"_readr_guess_types_", (DL_FUNC) &_readr_guess_types_, 6},
     {"_readr_type_convert_col", (DL_FUNC) &_readr_type_convert_col, 6},
     {"_readr_write_lines_", (DL_FUNC) &_readr_write_lines_, 4},
     {"_readr_write_lines_raw_", (DL_FUNC) &_readr_write_lines_raw_, 3},
@@ -361,7 +382,11 @@ static const R_CallMethodDef CallEntries[] = {
     {NULL, NULL, 0}
 };
 
+void init_dictionary_vector(DllInfo* dll);
+void init_lazy_column(DllInfo* dll);
 RcppExport void R_init_readr(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    init_dictionary_vector(dll);
+    init_lazy_column(dll);
 }
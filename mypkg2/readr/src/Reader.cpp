@@ -1,17 +1,24 @@
 #include "Reader.h"
+#include "TokenizerParallel.h"
 
 Reader::Reader(
     SourcePtr source,
     TokenizerPtr tokenizer,
     std::vector<CollectorPtr> collectors,
     bool progress,
-    CharacterVector colNames)
+    CharacterVector colNames,
+    int numThreads,
+    const RowFilter& filter)
     : source_(source),
       tokenizer_(tokenizer),
       collectors_(collectors),
       progress_(progress),
-      begun_(false) {
-  init(colNames);
+      begun_(false),
+      eof_(false),
+      filter_(filter),
+      rows_(0),
+      promoteAfter_(0) {
+  init(colNames, numThreads);
 }
 
 Reader::Reader(
@@ -23,26 +30,42 @@ Reader::Reader(
     : source_(source),
       tokenizer_(tokenizer),
       progress_(progress),
-      begun_(false) {
+      begun_(false),
+      eof_(false),
+      rows_(0),
+      promoteAfter_(0) {
 
   collectors_.push_back(collector);
   init(colNames);
 }
 
-void Reader::init(CharacterVector colNames) {
-  tokenizer_->tokenize(source_->begin(), source_->end());
-  tokenizer_->setWarnings(&warnings_);
+void Reader::init(CharacterVector colNames, int numThreads) {
+  // Tokenize in parallel if the tokenizer supports splitting its input
+  if (numThreads > 1 && tokenizer_->canClone()) {
+    tokenizer_ = TokenizerPtr(new TokenizerParallel(tokenizer_, numThreads));
+  }
+
+  warnings_.setMaxProblems(maxProblemsOption());
 
   // Work out which output columns we are keeping and set warnings for each
   // collector
   size_t p = collectors_.size();
+  std::vector<bool> keep(p, false);
   for (size_t j = 0; j < p; ++j) {
     if (!collectors_[j]->skip()) {
       keptColumns_.push_back(j);
+      keep[j] = true;
       collectors_[j]->setWarnings(&warnings_);
     }
   }
 
+  // The tokenizer does not need to build tokens for the skipped columns,
+  // unless the filter tests them
+  filter_.keepColumns(&keep);
+  tokenizer_->setKeptColumns(keep);
+  tokenizer_->tokenize(source_->begin(), source_->end());
+  tokenizer_->setWarnings(filter_.empty() ? &warnings_ : &batchWarnings_);
+
   if (colNames.size() > 0) {
     outNames_ = CharacterVector(keptColumns_.size());
     int i = 0;
@@ -54,6 +77,82 @@ void Reader::init(CharacterVector colNames) {
   }
 }
 
+void Reader::setLazy(LocaleInfoPtr pLocale) {
+  if (!hasLazyVectors())
+    return;
+
+  lazyColumns_.resize(collectors_.size());
+  for (std::vector<int>::const_iterator it = keptColumns_.begin();
+       it != keptColumns_.end();
+       ++it) {
+    if (collectors_[*it]->lazy()) {
+      lazyColumns_[*it] = LazyColumnPtr(new LazyColumn(
+          source_, tokenizer_, pLocale, collectors_[*it], *it));
+    }
+  }
+}
+
+void Reader::setPromote(LocaleInfoPtr pLocale, int failures) {
+  pPromoteLocale_ = pLocale;
+  promoteAfter_ = failures;
+
+  promotable_.resize(collectors_.size());
+  promotedTypes_.resize(collectors_.size());
+  for (std::vector<int>::const_iterator it = keptColumns_.begin();
+       it != keptColumns_.end();
+       ++it) {
+    if (isLazy(*it) || !collectors_[*it]->promotedType())
+      continue;
+
+    promotable_[*it] = PromotableColumnPtr(new PromotableColumn(*it));
+    promotable_[*it]->warnings.setMaxProblems(maxProblemsOption());
+    collectors_[*it]->setWarnings(&promotable_[*it]->warnings);
+  }
+}
+
+// Replaces the collector of column j with the next wider one for as long as
+// too many of its values fail to convert
+void Reader::promote(size_t j) {
+  PromotableColumn& column = *promotable_[j];
+
+  while (collectors_[j]->failures() >= promoteAfter_) {
+    if (!collectors_[j]->promotedType())
+      break;
+
+    CollectorPtr next = collectors_[j]->promote(pPromoteLocale_.get());
+    promotedTypes_[j] = collectors_[j]->promotedType();
+
+    // The problems of the old collector are found again by the new one if
+    // it can't convert the values either. That includes the problems with
+    // escapes, which are reported through the collector's warnings, not the
+    // tokenizer's, so they are never recorded twice.
+    column.warnings.clear();
+    next->setWarnings(&column.warnings);
+    next->resize(collectors_[j]->size());
+    column.fields.convert(next.get(), next->size());
+    collectors_[j] = next;
+  }
+
+  // Columns that can't be promoted any further no longer need their fields
+  if (!collectors_[j]->promotedType()) {
+    warnings_.append(column.warnings, 0);
+    collectors_[j]->setWarnings(&warnings_);
+    promotable_[j].reset();
+  }
+}
+
+// Moves the problems of the promotable columns into warnings_ at the end of
+// a read
+void Reader::mergePromotableWarnings() {
+  for (size_t j = 0; j < promotable_.size(); ++j) {
+    if (isPromotable(j)) {
+      warnings_.append(promotable_[j]->warnings, 0);
+      promotable_[j]->warnings.clear();
+    }
+  }
+  warnings_.sortRows(0);
+}
+
 RObject Reader::readToDataFrame(int lines) {
   int rows = read(lines);
 
@@ -63,13 +162,35 @@ RObject Reader::readToDataFrame(int lines) {
   for (std::vector<int>::const_iterator it = keptColumns_.begin();
        it != keptColumns_.end();
        ++it) {
-    out[j++] = collectors_[*it]->vector();
+    if (isLazy(*it)) {
+      lazyColumns_[*it]->resize(rows + 1);
+      out[j++] = makeLazyVector(lazyColumns_[*it]);
+    } else {
+      out[j++] = collectors_[*it]->vector();
+    }
   }
 
   out.attr("names") = outNames_;
   out.attr("class") = CharacterVector::create("tbl_df", "tbl", "data.frame");
   out.attr("row.names") = IntegerVector::create(NA_INTEGER, -(rows + 1));
 
+  // The type each promoted column was promoted to, by name, so the spec can
+  // be updated
+  std::vector<std::string> promoted, promotedNames;
+  for (size_t k = 0; k < keptColumns_.size() && !promotedTypes_.empty();
+       ++k) {
+    const std::string& type = promotedTypes_[keptColumns_[k]];
+    if (!type.empty()) {
+      promoted.push_back(type);
+      promotedNames.push_back(as<std::string>(outNames_[k]));
+    }
+  }
+  if (!promoted.empty()) {
+    CharacterVector types = wrap(promoted);
+    types.attr("names") = wrap(promotedNames);
+    out.attr("promoted") = types;
+  }
+
   out = warnings_.addAsAttribute(out);
 
   collectorsClear();
@@ -82,56 +203,135 @@ RObject Reader::readToDataFrame(int lines) {
 
 int Reader::read(int lines) {
 
-  if (t_.type() == TOKEN_EOF) {
+  if (eof_) {
     return (-1);
   }
 
   int n = (lines < 0) ? 1000 : lines;
 
+  // When reading the whole input, count its records first so that the
+  // collectors are allocated once at their final size. The count is only an
+  // estimate, so they still grow if more records are found.
+  if (lines < 0 && !begun_ && filter_.empty()) {
+    int records = tokenizer_->countRecords(source_->begin(), source_->end());
+    if (records >= 0) {
+      n = records;
+    }
+  }
+
   collectorsResize(n);
 
   int last_row = -1, last_col = -1, cells = 0;
   int first_row;
-  if (!begun_) {
-    t_ = tokenizer_->nextToken();
+  if (!filter_.empty()) {
+    // The rows of the records that pass the filter are numbered from the
+    // number already read
+    begun_ = true;
+    first_row = rows_;
+  } else if (!begun_) {
     begun_ = true;
     first_row = 0;
   } else {
-    first_row = t_.row();
+    first_row = -1;
   }
 
-  while (t_.type() != TOKEN_EOF) {
+  for (;;) {
+    // Rows are counted from first_row, so there can be gaps, e.g. for
+    // comments in the middle of a line. The first batch is limited to
+    // lines rows from its first row, which is first_row if it is not known
+    // yet, and later batches to the rows before first_row + lines.
+    int maxRows = TokenBatch::DEFAULT_ROWS, endRow = INT_MAX;
+    if (lines >= 0) {
+      if (last_row != -1 && last_row - first_row + 1 >= lines) {
+        break;
+      }
+      maxRows = std::min(maxRows, lines);
+      if (!filter_.empty()) {
+        // Each record passes the filter at most once, so reading no more
+        // records than are still needed never reads too many
+        if (last_row != -1) {
+          maxRows = std::min(maxRows, lines - (last_row - first_row + 1));
+        }
+      } else if (first_row != -1) {
+        endRow = first_row + lines;
+      }
+    }
 
-    if (progress_ && (++cells) % progressStep_ == 0) {
-      progressBar_.show(tokenizer_->progress());
+    // Problems are reported in row order, so keep track of where the
+    // problems of this batch start
+    size_t firstWarning = warnings_.size();
+
+    tokenizer_->nextBatch(&batch_, maxRows, endRow);
+    if (!filter_.empty()) {
+      filterBatch((last_row == -1) ? first_row : last_row + 1);
+    }
+    if (batch_.empty()) {
+      // Without a pending token the input is exhausted
+      eof_ = !batch_.hasPending();
+      break;
     }
 
-    if (t_.col() == 0 && static_cast<int>(t_.row()) != first_row) {
-      checkColumns(last_row, last_col, collectors_.size());
+    if (first_row == -1) {
+      first_row = batch_.row(0);
     }
 
-    if (lines >= 0 && static_cast<int>(t_.row()) - first_row >= lines) {
-      break;
+    if (progress_ && (cells + (int)batch_.size()) / progressStep_ >
+                         cells / progressStep_) {
+      progressBar_.show(tokenizer_->progress());
+    }
+    cells += batch_.size();
+
+    const TokenBatch& batch = filter_.empty() ? batch_ : filtered_;
+    if (batch.empty()) {
+      continue;
     }
 
-    if (static_cast<int>(t_.row()) - first_row >= n) {
+    int batch_last_row = batch.row(batch.size() - 1);
+    if (batch_last_row - first_row >= n) {
       // Estimate rows in full dataset and resize collectors
-      n = ((t_.row() - first_row) / tokenizer_->progress().first) * 1.1;
+      n = ((batch_last_row - first_row) / tokenizer_->progress().first) * 1.1;
+      n = std::max(n, batch_last_row - first_row + 1);
       collectorsResize(n);
     }
 
-    // only set value if within the expected number of columns
-    if (t_.col() < collectors_.size()) {
-      collectors_[t_.col()]->setValue(t_.row() - first_row, t_);
+    // only set values within the expected number of columns
+    size_t p = std::min(batch.columns(), collectors_.size());
+    for (size_t j = 0; j < p; ++j) {
+      if (isLazy(j)) {
+        lazyColumns_[j]->append(batch, first_row);
+      } else {
+        collectors_[j]->setValues(batch, j, first_row);
+        if (isPromotable(j)) {
+          promotable_[j]->fields.append(batch, first_row);
+          promote(j);
+        }
+      }
+    }
+
+    // The tokens of skipped columns may be missing, so a new row is not
+    // always started by column 0
+    for (size_t i = 0; i < batch.size(); ++i) {
+      int row = batch.row(i), col = batch.col(i);
+      if (row != last_row && last_row != -1) {
+        checkColumns(last_row, last_col, collectors_.size());
+      }
+
+      last_row = row;
+      last_col = col;
     }
 
-    last_row = t_.row();
-    last_col = t_.col();
-    t_ = tokenizer_->nextToken();
+    warnings_.sortRows(firstWarning);
   }
 
   if (last_row != -1) {
     checkColumns(last_row, last_col, collectors_.size());
+    rows_ = last_row + 1;
+  }
+  if (eof_) {
+    laterWarnings_.clear();
+  }
+  if (!promotable_.empty()) {
+    mergePromotableWarnings();
   }
 
   if (progress_) {
@@ -144,6 +344,7 @@ int Reader::read(int lines) {
   // size)
   if (last_row == -1) {
     collectorsResize(0);
+    return -1;
   } else if ((last_row - first_row) < (n - 1)) {
     collectorsResize((last_row - first_row) + 1);
   }
@@ -151,6 +352,22 @@ int Reader::read(int lines) {
   return last_row - first_row;
 }
 
+// Keeps the records of the batch that pass the filter in filtered_, numbered
+// from row, and moves their problems to the same rows
+void Reader::filterBatch(int row) {
+  // The tokenizer may report problems with records after the batch, these
+  // are held back until the records are read
+  batchWarnings_.append(laterWarnings_, 0);
+  laterWarnings_.clear();
+
+  filter_.apply(batch_, row, &filtered_, &filteredRows_);
+
+  int first = batch_.empty() ? 0 : batch_.row(0);
+  batchWarnings_.remapRows(0, first, filteredRows_, &laterWarnings_);
+  warnings_.append(batchWarnings_, 0);
+  batchWarnings_.clear();
+}
+
 void Reader::checkColumns(int i, int j, int n) {
   if (j + 1 == n)
     return;
@@ -159,14 +376,26 @@ void Reader::checkColumns(int i, int j, int n) {
       i, -1, tfm::format("%i columns", n), tfm::format("%i columns", j + 1));
 }
 
+// The collectors of lazy columns are only sized when they are converted, but
+// their fields are reserved
 void Reader::collectorsResize(int n) {
   for (size_t j = 0; j < collectors_.size(); ++j) {
-    collectors_[j]->resize(n);
+    if (isLazy(j)) {
+      lazyColumns_[j]->reserve(n);
+    } else {
+      collectors_[j]->resize(n);
+    }
+    if (isPromotable(j)) {
+      promotable_[j]->fields.reserve(n);
+    }
   }
 }
 
 void Reader::collectorsClear() {
   for (size_t j = 0; j < collectors_.size(); ++j) {
-    collectors_[j]->clear();
+    if (!isLazy(j))
+      collectors_[j]->clear();
+    if (isPromotable(j))
+      promotable_[j]->fields.clear();
   }
 }
@@ -1,8 +1,12 @@
 #include <Rcpp.h>
 
 #include "Collector.h"
+#include "ColumnFields.h"
+#include "LazyColumn.h"
 #include "Progress.h"
+#include "RowFilter.h"
 #include "Source.h"
+#include "TokenBatch.h"
 
 using namespace Rcpp;
 
@@ -13,7 +17,9 @@ public:
       TokenizerPtr tokenizer,
       std::vector<CollectorPtr> collectors,
       bool progress = true,
-      CharacterVector colNames = CharacterVector());
+      CharacterVector colNames = CharacterVector(),
+      int numThreads = 1,
+      const RowFilter& filter = RowFilter());
 
   Reader(
       SourcePtr source,
@@ -22,6 +28,20 @@ public:
       bool progress = true,
       CharacterVector colNames = CharacterVector());
 
+  // Keep the fields of the columns whose collectors allow it, and return
+  // them from readToDataFrame() as vectors that are converted when they are
+  // first used. pLocale must be the locale of the collectors. Has no effect
+  // in versions of R without ALTREP.
+  void setLazy(LocaleInfoPtr pLocale);
+
+  // Replace the collector of each column converted as it is read with one of
+  // a wider type (see Collector::promote()) once `failures` of its values
+  // have failed to convert. The fields of the rows already read are kept,
+  // and converted again by the new collector, so the input is not read
+  // again. pLocale must be the locale of the collectors. Call after
+  // setLazy().
+  void setPromote(LocaleInfoPtr pLocale, int failures);
+
   RObject readToDataFrame(int lines = -1);
 
   template <typename T> T readToVector(int lines) {
@@ -47,14 +67,58 @@ private:
   Progress progressBar_;
   std::vector<int> keptColumns_;
   CharacterVector outNames_;
-  bool begun_;
-  Token t_;
+  bool begun_, eof_;
+  TokenBatch batch_;
+
+  // Records that fail the filter are dropped before they reach the
+  // collectors, and the rows of the rest are renumbered without gaps
+  RowFilter filter_;
+  TokenBatch filtered_;
+  std::vector<int> filteredRows_;
+  Warnings laterWarnings_;
+
+  // With a filter, the tokenizer's problems go to batchWarnings_, which
+  // keeps them all, so that they are renumbered or dropped before they are
+  // counted in warnings_
+  Warnings batchWarnings_;
+  int rows_;
+
+  // The fields of the columns read lazily, or NULL for the columns that are
+  // converted as they are read
+  std::vector<LazyColumnPtr> lazyColumns_;
+
+  // A column that may still be promoted keeps the fields read so far, and
+  // its problems, which are replaced when it is promoted, until the end of
+  // each read
+  struct PromotableColumn {
+    ColumnFields fields;
+    Warnings warnings;
+
+    PromotableColumn(int col) : fields(col) {}
+  };
+  typedef boost::shared_ptr<PromotableColumn> PromotableColumnPtr;
+
+  LocaleInfoPtr pPromoteLocale_;
+  std::vector<PromotableColumnPtr> promotable_;
+  int promoteAfter_;
+
+  // Name of the type each column was promoted to, or empty
+  std::vector<std::string> promotedTypes_;
 
   const static int progressStep_ = 10000;
 
-  void init(CharacterVector colNames);
+  void init(CharacterVector colNames, int numThreads = 1);
   int read(int lines = -1);
+  void filterBatch(int row);
   void checkColumns(int i, int j, int n);
+  bool isLazy(size_t j) const {
+    return j < lazyColumns_.size() && lazyColumns_[j];
+  }
+  bool isPromotable(size_t j) const {
+    return j < promotable_.size() && promotable_[j];
+  }
+  void promote(size_t j);
+  void mergePromotableWarnings();
 
   void collectorsResize(int n);
   void collectorsClear();
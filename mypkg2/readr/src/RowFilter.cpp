@@ -0,0 +1,153 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "DoubleParser.h"
+#include "RowFilter.h"
+
+#include <algorithm>
+#include <string.h>
+
+RowPredicate::RowPredicate(List spec, LocaleInfo* pLocale)
+    : col_(as<int>(spec["col"])),
+      min_(R_NegInf),
+      max_(R_PosInf),
+      decimalMark_(pLocale->decimalMark_) {
+
+  std::string type = as<std::string>(spec["type"]);
+  if (type == "equals" || type == "in") {
+    type_ = PREDICATE_IN;
+  } else if (type == "prefix") {
+    type_ = PREDICATE_PREFIX;
+  } else if (type == "range") {
+    type_ = PREDICATE_RANGE;
+    min_ = as<double>(spec["min"]);
+    max_ = as<double>(spec["max"]);
+  } else {
+    Rcpp::stop("Unknown filter type '%s'", type);
+  }
+
+  if (type_ != PREDICATE_RANGE) {
+    values_ = as<std::vector<std::string> >(spec["values"]);
+    std::sort(values_.begin(), values_.end());
+  }
+}
+
+bool RowPredicate::test(const Token& t) const {
+  switch (t.type()) {
+  case TOKEN_STRING: {
+    SourceIterators str = t.getString(&buffer_);
+    return test(str.first, str.second);
+  }
+  case TOKEN_EMPTY:
+    return test(NULL, NULL);
+  case TOKEN_MISSING:
+  case TOKEN_EOF:
+    return false;
+  }
+
+  return false;
+}
+
+// Compares the string from begin to end with value, like std::string would
+static int
+compare(const char* begin, const char* end, const std::string& value) {
+  size_t n = end - begin, m = value.size();
+  int cmp = n == 0 ? 0 : memcmp(begin, value.data(), std::min(n, m));
+  if (cmp != 0)
+    return cmp;
+  return n < m ? -1 : (n > m ? 1 : 0);
+}
+
+bool RowPredicate::test(const char* begin, const char* end) const {
+  switch (type_) {
+  case PREDICATE_IN: {
+    size_t lo = 0, hi = values_.size();
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      int cmp = compare(begin, end, values_[mid]);
+      if (cmp == 0)
+        return true;
+      if (cmp < 0) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return false;
+  }
+  case PREDICATE_PREFIX: {
+    size_t n = end - begin;
+    for (size_t k = 0; k < values_.size(); ++k) {
+      const std::string& value = values_[k];
+      if (value.size() <= n &&
+          (value.empty() || memcmp(begin, value.data(), value.size()) == 0))
+        return true;
+    }
+    return false;
+  }
+  case PREDICATE_RANGE: {
+    double value;
+    if (begin == end || !parseDouble(decimalMark_, begin, end, value) ||
+        begin != end)
+      return false;
+    return value >= min_ && value <= max_;
+  }
+  }
+
+  return false;
+}
+
+RowFilter::RowFilter(ListOf<List> specs, LocaleInfo* pLocale) {
+  for (int i = 0; i < specs.size(); ++i) {
+    predicates_.push_back(RowPredicate(specs[i], pLocale));
+  }
+}
+
+void RowFilter::keepColumns(std::vector<bool>* pKeep) const {
+  for (size_t k = 0; k < predicates_.size(); ++k) {
+    size_t col = predicates_[k].col();
+    if (col >= pKeep->size())
+      Rcpp::stop("Filter column %i is out of range", (int)col + 1);
+    (*pKeep)[col] = true;
+  }
+}
+
+void RowFilter::apply(
+    const TokenBatch& batch,
+    int firstRow,
+    TokenBatch* pOut,
+    std::vector<int>* pRows) const {
+  pOut->clear();
+  pRows->clear();
+  if (batch.empty())
+    return;
+
+  // Count the predicates each row passes. A row that is too short to have a
+  // predicate's column fails it.
+  int first = batch.row(0), n = batch.row(batch.size() - 1) - first + 1;
+  passed_.assign(n, 0);
+  for (size_t k = 0; k < predicates_.size(); ++k) {
+    const RowPredicate& predicate = predicates_[k];
+    if ((size_t)predicate.col() >= batch.columns())
+      continue;
+
+    const std::vector<int>& tokens = batch.column(predicate.col());
+    for (size_t t = 0; t < tokens.size(); ++t) {
+      size_t i = tokens[t];
+      if (predicate.test(batch.token(i)))
+        passed_[batch.row(i) - first]++;
+    }
+  }
+
+  int next = firstRow, needed = predicates_.size();
+  pRows->resize(n);
+  for (int r = 0; r < n; ++r) {
+    (*pRows)[r] = (passed_[r] == needed) ? next++ : -1;
+  }
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    int row = (*pRows)[batch.row(i) - first];
+    if (row != -1)
+      pOut->push_back(batch, i, row);
+  }
+}
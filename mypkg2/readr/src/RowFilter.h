@@ -0,0 +1,65 @@
+#ifndef FASTREAD_ROWFILTER_H_
+#define FASTREAD_ROWFILTER_H_
+
+#include "LocaleInfo.h"
+#include "TokenBatch.h"
+#include <Rcpp.h>
+#include <string>
+#include <vector>
+
+enum PredicateType {
+  PREDICATE_IN,     // the value is one of a set of strings
+  PREDICATE_PREFIX, // the value starts with one of a set of strings
+  PREDICATE_RANGE   // the value is a number between min and max
+};
+
+// A test of the text of one column, before it is converted by its collector.
+// Missing values never pass.
+class RowPredicate {
+  int col_;
+  PredicateType type_;
+  std::vector<std::string> values_; // sorted
+  double min_, max_;
+  char decimalMark_;
+
+  // Escaped fields are unescaped into buffer_, which is reused
+  mutable boost::container::string buffer_;
+
+public:
+  RowPredicate(Rcpp::List spec, LocaleInfo* pLocale);
+
+  int col() const { return col_; }
+
+  bool test(const Token& t) const;
+
+private:
+  bool test(const char* begin, const char* end) const;
+};
+
+// Keeps the records for which all predicates hold
+class RowFilter {
+  std::vector<RowPredicate> predicates_;
+
+  // Number of predicates passed by each row of the batch being filtered
+  mutable std::vector<int> passed_;
+
+public:
+  RowFilter() {}
+  RowFilter(Rcpp::ListOf<Rcpp::List> specs, LocaleInfo* pLocale);
+
+  bool empty() const { return predicates_.empty(); }
+
+  // Mark the columns the predicates need to see
+  void keepColumns(std::vector<bool>* pKeep) const;
+
+  // Copy the tokens of the records of batch that pass into pOut, numbering
+  // them from firstRow without gaps. pRows is set to the new row of each
+  // row of batch, counted from its first row, or -1 if the row was dropped.
+  void apply(
+      const TokenBatch& batch,
+      int firstRow,
+      TokenBatch* pOut,
+      std::vector<int>* pRows) const;
+};
+
+#endif
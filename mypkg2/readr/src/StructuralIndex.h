@@ -0,0 +1,394 @@
+#ifndef FASTREAD_STRUCTURAL_INDEX_H_
+#define FASTREAD_STRUCTURAL_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Structural index for delimited input.
+//
+// The input is classified 64 bytes at a time into bitmasks of the characters
+// that can change the state of the delimited tokenizer (delimiters, quotes,
+// line endings, escapes, comment starts and embedded nulls). The tokenizer
+// then only visits the set bits of the mask relevant to its current state and
+// skips all other bytes. Each byte is classified once, no matter how many
+// fields share its block.
+class StructuralIndex {
+public:
+  enum { BLOCK_SIZE = 64 };
+
+private:
+  const char *begin_, *end_;
+  const char* block_;
+
+  char delim_, quote_, comment_;
+  bool escapeBackslash_, hasComment_;
+
+  // Bitmasks for the current block: bit i is set if block_[i] matters when
+  // inside an unquoted field, inside a quoted string, or inside a comment.
+  uint64_t field_, string_, line_;
+
+public:
+  StructuralIndex()
+      : begin_(NULL),
+        end_(NULL),
+        block_(NULL),
+        delim_(','),
+        quote_('"'),
+        comment_('\0'),
+        escapeBackslash_(false),
+        hasComment_(false),
+        field_(0),
+        string_(0),
+        line_(0) {}
+
+  void init(
+      const char* begin,
+      const char* end,
+      char delim,
+      char quote,
+      bool escapeBackslash,
+      bool hasComment,
+      char comment) {
+    begin_ = begin;
+    end_ = end;
+    block_ = NULL;
+
+    delim_ = delim;
+    quote_ = quote;
+    escapeBackslash_ = escapeBackslash;
+    hasComment_ = hasComment;
+    comment_ = comment;
+  }
+
+  // Next byte at or after cur that can end an unquoted field
+  const char* nextField(const char* cur) {
+    return find(cur, &StructuralIndex::field_);
+  }
+
+  // Next byte at or after cur that can end a quoted string
+  const char* nextString(const char* cur) {
+    return find(cur, &StructuralIndex::string_);
+  }
+
+  // Next byte at or after cur that can end a comment
+  const char* nextLine(const char* cur) {
+    return find(cur, &StructuralIndex::line_);
+  }
+
+  // First delimiter or line ending at or after cur, or end. Unlike the
+  // methods above this does not classify whole blocks, so it is faster when
+  // only these characters matter and fields are short.
+  static const char* findDelimOrLine(
+      const char* cur, const char* end, char delim) {
+#if defined(__SSE2__)
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; end - cur >= 16; cur += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur));
+      uint64_t bits = (uint32_t)_mm_movemask_epi8(_mm_or_si128(
+          _mm_cmpeq_epi8(v, d),
+          _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))));
+      if (bits != 0)
+        return cur + countTrailingZeros(bits);
+    }
+#endif
+    for (; cur != end; ++cur) {
+      if (*cur == delim || *cur == '\n' || *cur == '\r')
+        return cur;
+    }
+    return end;
+  }
+
+  // First line ending at or after cur, or end
+  static const char* findLine(const char* cur, const char* end) {
+    return findDelimOrLine(cur, end, '\n');
+  }
+
+  // Number of records in [begin, end): the lines that are not blank or
+  // comments, not counting line endings inside quoted strings. Leading
+  // spaces are ignored, as the tokenizer does. Every quote is taken to open
+  // or close a string, so the count is exact unless unquoted fields contain
+  // quotes.
+  //
+  // Without backslash escapes or comments the input is counted 64 bytes at
+  // a time: the bytes inside strings are found from the parity of the
+  // quotes before them, and a record starts at the first byte after a line
+  // ending, and any spaces, that is not inside a string.
+  static size_t countRecords(
+      const char* begin,
+      const char* end,
+      char quote,
+      bool escapeBackslash,
+      const std::string& comment) {
+    if (escapeBackslash || !comment.empty())
+      return countRecordsScalar(begin, end, quote, escapeBackslash, comment);
+
+    size_t n = 0;
+    // Whether the string, and the spaces after a line ending, run on from
+    // the previous block
+    uint64_t inString = 0, lineStart = 1;
+    for (const char* block = begin; block < end; block += BLOCK_SIZE) {
+      ptrdiff_t size = end - block < BLOCK_SIZE ? end - block : BLOCK_SIZE;
+      uint64_t quotes, eol, spaces;
+      classifyLines(block, size, quote, &quotes, &eol, &spaces);
+
+      // Bytes after an odd number of quotes are inside strings
+      uint64_t inside = prefixXor(quotes) ^ quotes ^ inString;
+
+      // Adding the first bit of a run of spaces that follows a line ending
+      // carries through the run to the byte after it
+      uint64_t seeds = (eol << 1) | lineStart;
+      uint64_t sum = spaces + (seeds & spaces);
+      uint64_t starts = ((sum & ~spaces) | (seeds & ~spaces)) & ~eol & ~inside;
+      if (size < BLOCK_SIZE)
+        starts &= ((uint64_t)1 << size) - 1;
+      n += popCount(starts);
+
+      inString = (uint64_t)0 - ((inside ^ quotes) >> 63);
+      lineStart = (eol >> 63) | (sum < spaces);
+    }
+
+    return n;
+  }
+
+private:
+  const char* find(const char* cur, uint64_t StructuralIndex::*mask) {
+    while (cur < end_) {
+      if (block_ == NULL || cur < block_ || cur >= block_ + BLOCK_SIZE)
+        classify(begin_ + ((cur - begin_) / BLOCK_SIZE) * BLOCK_SIZE);
+
+      uint64_t bits = (this->*mask) >> (cur - block_);
+      if (bits != 0)
+        return cur + countTrailingZeros(bits);
+
+      cur = block_ + BLOCK_SIZE;
+    }
+
+    return end_;
+  }
+
+  static size_t countRecordsScalar(
+      const char* begin,
+      const char* end,
+      char quote,
+      bool escapeBackslash,
+      const std::string& comment) {
+    size_t n = 0;
+    bool lineStart = true, inString = false, inComment = false;
+    for (const char* cur = begin; cur < end; ++cur) {
+      char c = *cur;
+      bool isEol = c == '\n' || c == '\r';
+      if (inComment) {
+        if (isEol) {
+          inComment = false;
+          lineStart = true;
+        }
+      } else if (inString) {
+        if (c == quote) {
+          inString = false;
+        } else if (escapeBackslash && c == '\\' && cur + 1 < end) {
+          ++cur;
+        }
+      } else if (isEol) {
+        lineStart = true;
+      } else if (lineStart && c == ' ') {
+        continue;
+      } else if (
+          !comment.empty() && (size_t)(end - cur) >= comment.size() &&
+          memcmp(cur, comment.data(), comment.size()) == 0) {
+        inComment = true;
+        lineStart = false;
+      } else {
+        if (lineStart)
+          ++n;
+        lineStart = false;
+
+        if (c == quote) {
+          inString = true;
+        } else if (escapeBackslash && c == '\\' && cur + 1 < end) {
+          ++cur;
+        }
+      }
+    }
+
+    return n;
+  }
+
+  // Bitmasks of the quotes, line endings and spaces in the first size bytes
+  // of block
+  static void classifyLines(
+      const char* block,
+      ptrdiff_t size,
+      char quote,
+      uint64_t* pQuotes,
+      uint64_t* pEol,
+      uint64_t* pSpaces) {
+    uint64_t quotes = 0, eol = 0, spaces = 0;
+#if defined(__SSE2__)
+    if (size == BLOCK_SIZE) {
+      const __m128i q = _mm_set1_epi8(quote);
+      const __m128i lf = _mm_set1_epi8('\n');
+      const __m128i cr = _mm_set1_epi8('\r');
+      const __m128i sp = _mm_set1_epi8(' ');
+      for (int i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        quotes |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q))
+                  << i;
+        eol |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_or_si128(
+                   _mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)))
+               << i;
+        spaces |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, sp))
+                  << i;
+      }
+      *pQuotes = quotes;
+      *pEol = eol;
+      *pSpaces = spaces;
+      return;
+    }
+#endif
+    for (ptrdiff_t i = 0; i < size; ++i) {
+      char c = block[i];
+      uint64_t bit = (uint64_t)1 << i;
+
+      quotes |= (c == quote) ? bit : 0;
+      eol |= (c == '\n' || c == '\r') ? bit : 0;
+      spaces |= (c == ' ') ? bit : 0;
+    }
+    *pQuotes = quotes;
+    *pEol = eol;
+    *pSpaces = spaces;
+  }
+
+  // Bit i of the result is the parity of bits 0 to i of x
+  static uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+  }
+
+  static int popCount(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x != 0; x &= x - 1)
+      n++;
+    return n;
+#endif
+  }
+
+  void classify(const char* block) {
+    block_ = block;
+
+    if (end_ - block < BLOCK_SIZE) {
+      classifyScalar(block, end_ - block);
+      return;
+    }
+
+#if defined(__AVX2__)
+    uint64_t delim = 0, quote = 0, eol = 0, escape = 0, comment = 0, null = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+      delim |= movemask(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(delim_))) << i;
+      quote |= movemask(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote_))) << i;
+      eol |= movemask(_mm256_or_si256(
+                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))))
+             << i;
+      null |= movemask(_mm256_cmpeq_epi8(v, _mm256_setzero_si256())) << i;
+      if (escapeBackslash_)
+        escape |= movemask(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+      if (hasComment_)
+        comment |= movemask(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(comment_)))
+                   << i;
+    }
+    setMasks(delim, quote, eol, escape, comment, null);
+#elif defined(__SSE2__)
+    uint64_t delim = 0, quote = 0, eol = 0, escape = 0, comment = 0, null = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+      delim |= movemask(_mm_cmpeq_epi8(v, _mm_set1_epi8(delim_))) << i;
+      quote |= movemask(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote_))) << i;
+      eol |= movemask(_mm_or_si128(
+                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))))
+             << i;
+      null |= movemask(_mm_cmpeq_epi8(v, _mm_setzero_si128())) << i;
+      if (escapeBackslash_)
+        escape |= movemask(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+      if (hasComment_)
+        comment |= movemask(_mm_cmpeq_epi8(v, _mm_set1_epi8(comment_))) << i;
+    }
+    setMasks(delim, quote, eol, escape, comment, null);
+#else
+    classifyScalar(block, BLOCK_SIZE);
+#endif
+  }
+
+  void classifyScalar(const char* block, ptrdiff_t n) {
+    uint64_t delim = 0, quote = 0, eol = 0, escape = 0, comment = 0, null = 0;
+    for (ptrdiff_t i = 0; i < n; ++i) {
+      char c = block[i];
+      uint64_t bit = (uint64_t)1 << i;
+
+      delim |= (c == delim_) ? bit : 0;
+      quote |= (c == quote_) ? bit : 0;
+      eol |= (c == '\n' || c == '\r') ? bit : 0;
+      null |= (c == '\0') ? bit : 0;
+      escape |= (escapeBackslash_ && c == '\\') ? bit : 0;
+      comment |= (hasComment_ && c == comment_) ? bit : 0;
+    }
+    setMasks(delim, quote, eol, escape, comment, null);
+  }
+
+  void setMasks(
+      uint64_t delim,
+      uint64_t quote,
+      uint64_t eol,
+      uint64_t escape,
+      uint64_t comment,
+      uint64_t null) {
+    field_ = delim | eol | escape | comment | null;
+    string_ = quote | escape | null;
+    line_ = eol | null;
+  }
+
+#if defined(__AVX2__)
+  static uint64_t movemask(__m256i x) {
+    return (uint32_t)_mm256_movemask_epi8(x);
+  }
+#elif defined(__SSE2__)
+  static uint64_t movemask(__m128i x) {
+    return (uint32_t)_mm_movemask_epi8(x);
+  }
+#endif
+
+  static int countTrailingZeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while ((x & 1) == 0) {
+      x >>= 1;
+      n++;
+    }
+    return n;
+#endif
+  }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "TimeZone.h"
+#include "localtime.h"
+
+#include <cmath>
+#include <limits>
+
+TimeZone::TimeZone(const std::string& name) : name_(name) {
+  tz_transitions zone;
+  tz_load(name.c_str(), &zone);
+
+  at_.assign(zone.at, zone.at + zone.count);
+  offset_.reserve(zone.count + 1);
+  offset_.push_back(zone.default_offset);
+  offset_.insert(offset_.end(), zone.offset, zone.offset + zone.count);
+  goback_ = zone.goback && zone.count > 0;
+  goahead_ = zone.goahead && zone.count > 0;
+  repeat_ = zone.repeat;
+
+  tz_free(&zone);
+}
+
+double TimeZone::toUTC(double local, Cache* pCache) const {
+  int day = std::floor(local / 86400);
+  if (pCache != NULL && pCache->day == day)
+    return local - pCache->offset;
+
+  double begin, end;
+  int offset = this->offset(local, &begin, &end);
+  if (offset == NA_INTEGER)
+    return NA_REAL;
+
+  if (pCache != NULL && begin <= day * 86400.0 && (day + 1) * 86400.0 <= end) {
+    pCache->day = day;
+    pCache->offset = offset;
+  }
+  return local - offset;
+}
+
+int TimeZone::offset(double local, double* pBegin, double* pEnd) const {
+  size_t n = at_.size();
+
+  // Like localsub(), times outside the transitions that follow a rule are
+  // moved into them by whole 400 year cycles
+  double shift = 0;
+  if (goback_ && local - offset_[0] < at_[0]) {
+    shift = (std::floor((at_[0] - local) / repeat_) + 1) * repeat_;
+  } else if (goahead_ && local - offset_[n] > at_[n - 1]) {
+    shift = -(std::floor((local - at_[n - 1]) / repeat_) + 1) * repeat_;
+  }
+  local += shift;
+
+  // Find the first offset that ends after local
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (local < localEnd(mid))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  const double inf = std::numeric_limits<double>::infinity();
+  *pBegin = (lo == 0 ? -inf : localBegin(lo)) - shift;
+  *pEnd = (lo == n ? inf : localEnd(lo)) - shift;
+
+  // Between the end of the previous offset and the beginning of this one
+  if (lo > 0 && local < localBegin(lo))
+    return NA_INTEGER;
+
+  return offset_[lo];
+}
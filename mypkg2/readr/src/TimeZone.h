@@ -0,0 +1,57 @@
+#ifndef FASTREAD_TIMEZONE_H_
+#define FASTREAD_TIMEZONE_H_
+
+#include <boost/shared_ptr.hpp>
+#include <climits>
+#include <string>
+#include <vector>
+
+class TimeZone;
+typedef boost::shared_ptr<TimeZone> TimeZonePtr;
+
+// The transitions of a time zone, read from its tzfile once so that local
+// times can be converted to UTC without going through the global state of
+// my_mktime(). A TimeZone is never changed after it is loaded, so it can be
+// shared by several threads as long as each one has its own Cache.
+class TimeZone {
+  std::string name_;
+
+  // Offset k applies from transition k - 1 (or the beginning of time) up
+  // to transition k (or the end of time), so there is one more offset than
+  // there are transitions.
+  std::vector<double> at_;
+  std::vector<int> offset_;
+  bool goback_, goahead_;
+  double repeat_;
+
+public:
+  // The offset of the local day converted last, if no transition happens
+  // on that day
+  struct Cache {
+    int day;
+    int offset;
+
+    Cache() : day(INT_MIN), offset(0) {}
+  };
+
+  // Names that can't be loaded give a warning, and fall back to UTC
+  explicit TimeZone(const std::string& name);
+
+  const std::string& name() const { return name_; }
+
+  // Converts a local time, in seconds since 1970-01-01T00:00:00 local time,
+  // to seconds since 1970-01-01T00:00:00Z. Times that happen twice when the
+  // clocks go back are the earlier of the two (my_mktime() picks either);
+  // times that are skipped when the clocks go forward are NA.
+  double toUTC(double local, Cache* pCache) const;
+
+private:
+  double localBegin(size_t k) const { return at_[k - 1] + offset_[k]; }
+  double localEnd(size_t k) const { return at_[k] + offset_[k]; }
+
+  // The offset in effect at local time local, or NA_INTEGER if it is
+  // skipped. The local times [*pBegin, *pEnd) all have the same offset.
+  int offset(double local, double* pBegin, double* pEnd) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define FASTREAD_TOKEN_H_
 
 #include "Iconv.h"
+#include "NaMatcher.h"
 #include "Source.h"
 #include "Tokenizer.h"
 #include <Rcpp.h>
@@ -22,6 +23,8 @@ class Token {
 
   Tokenizer* pTokenizer_;
 
+  friend class TokenBatch;
+
 public:
   Token() : type_(TOKEN_EMPTY), row_(0), col_(0) {}
   Token(TokenType type, int row, int col) : type_(type), row_(row), col_(col) {}
@@ -43,11 +46,11 @@ public:
       type_ = TOKEN_EMPTY;
   }
 
-  std::string asString() const {
+  std::string asString(Warnings* pWarnings = NULL) const {
     switch (type_) {
     case TOKEN_STRING: {
       boost::container::string buffer;
-      SourceIterators string = getString(&buffer);
+      SourceIterators string = getString(&buffer, pWarnings);
 
       return std::string(string.first, string.second);
     }
@@ -87,11 +90,18 @@ public:
 
   TokenType type() const { return type_; }
 
-  SourceIterators getString(boost::container::string* pOut) const {
+  // Whether getString() unescapes the field into its buffer
+  bool isEscaped() const { return pTokenizer_ != NULL; }
+
+  // The field, or if it is escaped, the field unescaped into *pOut, which
+  // replaces its contents. Reuse pOut across tokens to avoid allocating.
+  // Problems with the escapes are added to pWarnings, if given.
+  SourceIterators getString(
+      boost::container::string* pOut, Warnings* pWarnings = NULL) const {
     if (pTokenizer_ == NULL)
       return std::make_pair(begin_, end_);
 
-    pTokenizer_->unescape(begin_, end_, pOut);
+    pTokenizer_->unescapeInto(begin_, end_, row_, col_, pWarnings, pOut);
     return std::make_pair(pOut->data(), pOut->data() + pOut->size());
   }
 
@@ -112,18 +122,9 @@ public:
     return *this;
   }
 
-  Token& flagNA(const std::vector<std::string>& NA) {
-
-    std::vector<std::string>::const_iterator it;
-    for (it = NA.begin(); it != NA.end(); ++it) {
-      if ((size_t)(end_ - begin_) != it->size())
-        continue;
-
-      if (strncmp(begin_, it->data(), it->size()) == 0) {
-        type_ = TOKEN_MISSING;
-        break;
-      }
-    }
+  Token& flagNA(const NaMatcher& NA) {
+    if (NA.matches(begin_, end_))
+      type_ = TOKEN_MISSING;
 
     return *this;
   }
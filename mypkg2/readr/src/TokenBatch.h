@@ -0,0 +1,201 @@
+#ifndef FASTREAD_TOKENBATCH_H_
+#define FASTREAD_TOKENBATCH_H_
+
+#include "Token.h"
+#include "Tokenizer.h"
+#include <Rcpp.h>
+#include <vector>
+
+// The tokens of a run of whole records, stored as flat arrays in the order
+// they were read. The tokens of each column are also indexed separately, so
+// that a collector can convert its part of the batch in a single loop.
+class TokenBatch {
+public:
+  enum TokenFlags { FLAG_MISSING = 1, FLAG_NULL = 2, FLAG_ESCAPED = 4 };
+
+  // Number of records read at a time, unless the caller needs fewer
+  enum { DEFAULT_ROWS = 1000 };
+
+private:
+  std::vector<SourceIterator> begin_;
+  std::vector<int> length_;
+  std::vector<unsigned char> flags_;
+  std::vector<int> row_, col_;
+
+  // Positions of the tokens of each column. Only the first ncol_ are in use,
+  // the rest are kept to reuse their storage.
+  std::vector<std::vector<int> > columns_;
+  size_t ncol_;
+
+  // Tokenizer used to unescape the escaped tokens
+  Tokenizer* pTokenizer_;
+
+  // First token of the record following the batch
+  Token pending_;
+  bool hasPending_;
+
+  // Last token of a column that is not kept, stored only if no other token
+  // of its record follows it
+  Token skipped_;
+  bool hasSkipped_;
+
+public:
+  TokenBatch()
+      : ncol_(0), pTokenizer_(NULL), hasPending_(false), hasSkipped_(false) {}
+
+  size_t size() const { return row_.size(); }
+  bool empty() const { return row_.empty(); }
+
+  int row(size_t i) const { return row_[i]; }
+  int col(size_t i) const { return col_[i]; }
+
+  size_t columns() const { return ncol_; }
+  const std::vector<int>& column(size_t j) const { return columns_[j]; }
+
+  // The raw fields of the tokens, as they are stored
+  SourceIterator begin(size_t i) const { return begin_[i]; }
+  int length(size_t i) const { return length_[i]; }
+  unsigned char flags(size_t i) const { return flags_[i]; }
+  Tokenizer* tokenizer() const { return pTokenizer_; }
+
+  Token token(size_t i) const {
+    if (flags_[i] & FLAG_MISSING)
+      return Token(TOKEN_MISSING, row_[i], col_[i]);
+
+    return Token(
+        begin_[i],
+        begin_[i] + length_[i],
+        row_[i],
+        col_[i],
+        (flags_[i] & FLAG_NULL) != 0,
+        (flags_[i] & FLAG_ESCAPED) ? pTokenizer_ : NULL);
+  }
+
+  void push_back(const Token& t) {
+    if (hasSkipped_) {
+      hasSkipped_ = false;
+      if (skipped_.row() != t.row())
+        push_back(skipped_);
+    }
+
+    size_t i = row_.size();
+    int col = t.col();
+
+    switch (t.type()) {
+    case TOKEN_STRING:
+      begin_.push_back(t.begin_);
+      length_.push_back(t.end_ - t.begin_);
+      flags_.push_back(
+          (t.hasNull_ ? FLAG_NULL : 0) | (t.pTokenizer_ ? FLAG_ESCAPED : 0));
+      if (t.pTokenizer_ != NULL)
+        pTokenizer_ = t.pTokenizer_;
+      break;
+    case TOKEN_MISSING:
+      begin_.push_back(NULL);
+      length_.push_back(0);
+      flags_.push_back(FLAG_MISSING);
+      break;
+    case TOKEN_EMPTY:
+      begin_.push_back(NULL);
+      length_.push_back(0);
+      flags_.push_back(0);
+      break;
+    case TOKEN_EOF:
+      Rcpp::stop("Invalid token");
+    }
+    row_.push_back(t.row());
+    col_.push_back(col);
+    index(i, col);
+  }
+
+  // Append a token of a column that is not kept. It is only stored if it
+  // turns out to be the last token of its record.
+  void push_skipped(const Token& t) {
+    if (hasSkipped_ && skipped_.row() != t.row())
+      push_back(skipped_);
+
+    skipped_ = t;
+    hasSkipped_ = true;
+  }
+
+  // Store the last token pushed with push_skipped(), if no token of the same
+  // record has been pushed after it
+  void flushSkipped() {
+    if (hasSkipped_)
+      push_back(skipped_);
+  }
+
+  // Append the i-th token of another batch
+  void push_back(const TokenBatch& other, size_t i) {
+    push_back(other, i, other.row_[i]);
+  }
+
+  // Append the i-th token of another batch, moved to row
+  void push_back(const TokenBatch& other, size_t i, int row) {
+    size_t k = row_.size();
+    int col = other.col_[i];
+
+    begin_.push_back(other.begin_[i]);
+    length_.push_back(other.length_[i]);
+    flags_.push_back(other.flags_[i]);
+    if (other.flags_[i] & FLAG_ESCAPED)
+      pTokenizer_ = other.pTokenizer_;
+    row_.push_back(row);
+    col_.push_back(col);
+    index(k, col);
+  }
+
+  // Unescape the escaped tokens with pTokenizer, instead of the tokenizer
+  // that read them
+  void setTokenizer(Tokenizer* pTokenizer) { pTokenizer_ = pTokenizer; }
+
+  // Shift the rows of all tokens down by offset
+  void offsetRows(int offset) {
+    for (size_t i = 0; i < row_.size(); ++i) {
+      row_[i] += offset;
+    }
+  }
+
+  // Empties the batch, but keeps the pending token
+  void clear() {
+    hasSkipped_ = false;
+    begin_.clear();
+    length_.clear();
+    flags_.clear();
+    row_.clear();
+    col_.clear();
+    for (size_t j = 0; j < ncol_; ++j) {
+      columns_[j].clear();
+    }
+    ncol_ = 0;
+  }
+
+  // Empties the batch and drops the pending token
+  void reset() {
+    clear();
+    hasPending_ = false;
+  }
+
+  bool hasPending() const { return hasPending_; }
+
+  void setPending(const Token& t) {
+    pending_ = t;
+    hasPending_ = true;
+  }
+
+  Token takePending() {
+    hasPending_ = false;
+    return pending_;
+  }
+
+private:
+  void index(size_t i, int col) {
+    if ((size_t)col >= columns_.size())
+      columns_.resize(col + 1);
+    if ((size_t)col >= ncol_)
+      ncol_ = col + 1;
+    columns_[col].push_back(i);
+  }
+};
+
+#endif
@@ -2,6 +2,7 @@
 using namespace Rcpp;
 
 #include "Tokenizer.h"
+#include "TokenBatch.h"
 #include "TokenizerDelim.h"
 #include "TokenizerFwf.h"
 #include "TokenizerLine.h"
@@ -21,7 +22,7 @@ TokenizerPtr Tokenizer::create(List spec) {
     bool escapeBackslash = as<bool>(spec["escape_backslash"]);
     bool quotedNA = as<bool>(spec["quoted_na"]);
 
-    return TokenizerPtr(new TokenizerDelim(
+    TokenizerDelim tokenizer(
         delim,
         quote,
         na,
@@ -29,7 +30,33 @@ TokenizerPtr Tokenizer::create(List spec) {
         trimWs,
         escapeBackslash,
         escapeDouble,
-        quotedNA));
+        quotedNA);
+
+    // Use a specialised tokenizer for the most common dialects
+    if (!escapeBackslash && comment.empty()) {
+      if (quote == '"' && escapeDouble) {
+        switch (delim) {
+        case ',':
+          return TokenizerPtr(
+              new TokenizerDelimDialect<DialectCsv>(tokenizer));
+        case ';':
+          return TokenizerPtr(
+              new TokenizerDelimDialect<DialectCsv2>(tokenizer));
+        case '\t':
+          return TokenizerPtr(
+              new TokenizerDelimDialect<DialectTsv>(tokenizer));
+        case '|':
+          return TokenizerPtr(
+              new TokenizerDelimDialect<DialectPipe>(tokenizer));
+        }
+      } else if (quote == '\0') {
+        // quote = "" gives a null quote character
+        return TokenizerPtr(
+            new TokenizerDelimDialect<DialectUnquoted>(tokenizer));
+      }
+    }
+
+    return TokenizerPtr(new TokenizerDelim(tokenizer));
   } else if (subclass == "tokenizer_fwf") {
     std::vector<int> begin = as<std::vector<int> >(spec["begin"]),
                      end = as<std::vector<int> >(spec["end"]);
@@ -52,3 +79,37 @@ TokenizerPtr Tokenizer::create(List spec) {
   Rcpp::stop("Unknown tokenizer type");
   return TokenizerPtr();
 }
+
+void Tokenizer::nextBatch(TokenBatch* pBatch, int maxRows, int endRow) {
+  pBatch->clear();
+
+  Token t = pBatch->hasPending() ? pBatch->takePending() : nextToken();
+  int firstRow = t.row();
+
+  while (t.type() != TOKEN_EOF) {
+    // Keep the first token of the record after the batch for the next call
+    if ((int)t.row() - firstRow >= maxRows || (int)t.row() >= endRow) {
+      pBatch->setPending(t);
+      break;
+    }
+
+    if (isKept(t.col())) {
+      pBatch->push_back(t);
+    } else {
+      pBatch->push_skipped(t);
+    }
+    t = nextToken();
+  }
+
+  pBatch->flushSkipped();
+}
+
+void Tokenizer::setKeptColumns(const std::vector<bool>& keep) {
+  keep_ = keep;
+
+  lastKept_ = keep_.empty() ? INT_MAX : -1;
+  for (size_t j = 0; j < keep_.size(); ++j) {
+    if (keep_[j])
+      lastKept_ = j;
+  }
+}
@@ -4,7 +4,9 @@
 #include "Warnings.h"
 #include "boost.h"
 #include <Rcpp.h>
+#include <limits.h>
 class Token;
+class TokenBatch;
 
 typedef const char* SourceIterator;
 typedef std::pair<SourceIterator, SourceIterator> SourceIterators;
@@ -15,28 +17,87 @@ class Tokenizer;
 typedef boost::shared_ptr<Tokenizer> TokenizerPtr;
 
 class Tokenizer {
+protected:
   Warnings* pWarnings_;
 
+  // Columns whose fields are needed, or empty if all of them are
+  std::vector<bool> keep_;
+  int lastKept_;
+
 public:
-  Tokenizer() : pWarnings_(NULL) {}
+  Tokenizer() : pWarnings_(NULL), lastKept_(INT_MAX) {}
   virtual ~Tokenizer() {}
 
   virtual void tokenize(SourceIterator begin, SourceIterator end) = 0;
   virtual Token nextToken() = 0;
+  // Replaces the contents of pBatch with the tokens of the next maxRows
+  // records, or fewer at the end of the input. Records on rows from endRow
+  // on are left for later calls, in which case pBatch has a pending token.
+  virtual void nextBatch(TokenBatch* pBatch, int maxRows, int endRow = INT_MAX);
   // Percentage & bytes
   virtual std::pair<double, size_t> progress() = 0;
 
-  virtual void unescape(
+  // Replaces the contents of pOut with the field from begin to end,
+  // unescaped. Problems with the escapes are added to pWarnings, unless it
+  // is NULL, as problems of the field on row and col. Callers reuse pOut
+  // from field to field, so it only allocates when a field is longer than
+  // all those before it.
+  void unescapeInto(
       SourceIterator begin,
       SourceIterator end,
+      int row,
+      int col,
+      Warnings* pWarnings,
       boost::container::string* pOut) {
+    pOut->clear();
     pOut->reserve(end - begin);
-    for (SourceIterator cur = begin; cur != end; ++cur)
-      pOut->push_back(*cur);
+    unescape(begin, end, row, col, pWarnings, pOut);
+  }
+
+  // Appends the field from begin to end, unescaped, to pOut, which has room
+  // for end - begin bytes. Unescaping never uses the tokenizer's own
+  // warnings, as fields may be unescaped long after they were tokenized.
+  virtual void unescape(
+      SourceIterator begin,
+      SourceIterator end,
+      int row,
+      int col,
+      Warnings* pWarnings,
+      boost::container::string* pOut) {
+    pOut->append(begin, end);
   }
 
+  // Number of records in [begin, end), found without tokenizing the fields,
+  // or -1 if the tokenizer can't count them that way. The count may be
+  // wrong for malformed input, so it must only be used as an estimate.
+  virtual int countRecords(SourceIterator begin, SourceIterator end) const {
+    return -1;
+  }
+
+  // Tokenizers that can be run independently on byte ranges of the input
+  // split at line endings return a copy of themselves. The copy must never
+  // call back into R, so that it can be used from worker threads.
+  virtual TokenizerPtr clone() const { return TokenizerPtr(); }
+
+  // Whether clone() returns a copy, found without making one
+  virtual bool canClone() const { return false; }
+
+  // Once the input is exhausted, did it end between two records? If so the
+  // input that follows can be tokenized independently.
+  virtual bool atRecordBoundary() const { return true; }
+
   void setWarnings(Warnings* pWarnings) { pWarnings_ = pWarnings; }
 
+  // Only the fields of the columns j with keep[j] true are needed (columns
+  // past the end of keep are not). Tokenizers do not trim or check for NA
+  // the fields of the other columns, and nextBatch() leaves them out unless
+  // they end their record, so that the number of columns is still known.
+  virtual void setKeptColumns(const std::vector<bool>& keep);
+
+  bool isKept(int col) const {
+    return keep_.empty() || ((size_t)col < keep_.size() && keep_[col]);
+  }
+
   inline void warn(
       int row,
       int col,
@@ -3,6 +3,8 @@ using namespace Rcpp;
 
 #include "TokenizerDelim.h"
 
+#include <string.h>
+
 TokenizerDelim::TokenizerDelim(
     char delim,
     char quote,
@@ -21,25 +23,41 @@ TokenizerDelim::TokenizerDelim(
       escapeBackslash_(escapeBackslash),
       escapeDouble_(escapeDouble),
       quotedNA_(quotedNA),
-      hasEmptyNA_(false),
-      moreTokens_(false) {
-  for (size_t i = 0; i < NA_.size(); ++i) {
-    if (NA_[i] == "") {
-      hasEmptyNA_ = true;
-      break;
-    }
-  }
-}
+      hasEmptyNA_(NA_.matchesEmpty()),
+      quotedNull_(false),
+      begin_(NULL),
+      cur_(NULL),
+      end_(NULL),
+      nextInterrupt_(NULL),
+      moreTokens_(false),
+      interruptible_(true),
+      batchPos_(0) {}
 
 void TokenizerDelim::tokenize(SourceIterator begin, SourceIterator end) {
   cur_ = begin;
   begin_ = begin;
   end_ = end;
 
+  index_.init(
+      begin,
+      end,
+      delim_,
+      quote_,
+      escapeBackslash_,
+      hasComment_,
+      hasComment_ ? comment_[0] : '\0');
+
+  quotedNull_ = quote_ == '\0' && memchr(begin, '\0', end - begin) != NULL;
+
+  nextInterrupt_ = begin + 131072;
+
   row_ = 0;
   col_ = 0;
   state_ = STATE_DELIM;
   moreTokens_ = true;
+
+  batch_.reset();
+  batchPos_ = 0;
 }
 
 std::pair<double, size_t> TokenizerDelim::progress() {
@@ -48,6 +66,48 @@ std::pair<double, size_t> TokenizerDelim::progress() {
 }
 
 Token TokenizerDelim::nextToken() {
+  if (batchPos_ == batch_.size()) {
+    nextBatch(&batch_, TokenBatch::DEFAULT_ROWS);
+    batchPos_ = 0;
+
+    if (batch_.empty())
+      return Token(TOKEN_EOF, row_, col_);
+  }
+
+  return batch_.token(batchPos_++);
+}
+
+void TokenizerDelim::nextBatch(TokenBatch* pBatch, int maxRows, int endRow) {
+  fillBatch<DialectGeneric>(pBatch, maxRows, endRow);
+}
+
+template <class D>
+void TokenizerDelim::fillBatch(
+    TokenBatch* pBatch, int maxRows, int endRow) {
+  pBatch->clear();
+
+  Token t = pBatch->hasPending() ? pBatch->takePending() : scanToken<D>();
+  int firstRow = t.row();
+
+  while (t.type() != TOKEN_EOF) {
+    // Keep the first token of the record after the batch for the next call
+    if ((int)t.row() - firstRow >= maxRows || (int)t.row() >= endRow) {
+      pBatch->setPending(t);
+      break;
+    }
+
+    if (isKept(t.col())) {
+      pBatch->push_back(t);
+    } else {
+      pBatch->push_skipped(t);
+    }
+    t = scanToken<D>();
+  }
+
+  pBatch->flushSkipped();
+}
+
+template <class D> Token TokenizerDelim::scanToken() {
   // Capture current position
   int row = row_, col = col_;
 
@@ -58,6 +118,35 @@ Token TokenizerDelim::nextToken() {
   bool hasEscapeD = false, hasEscapeB = false, hasNull = false;
 
   while (cur_ != end_) {
+    // Inside fields, strings and comments only a few characters can change
+    // the state, so jump straight to the next one of those.
+    switch (state_) {
+    case STATE_FIELD:
+      cur_ = index_.nextField(cur_);
+      break;
+    case STATE_STRING:
+      cur_ = index_.nextString(cur_);
+      break;
+    case STATE_COMMENT:
+      cur_ = index_.nextLine(cur_);
+      break;
+    case STATE_DELIM:
+      while (cur_ != end_ && *cur_ == ' ') {
+        ++cur_;
+      }
+      break;
+    default:
+      break;
+    }
+
+    if (cur_ == end_)
+      break;
+
+    if (interruptible_ && cur_ >= nextInterrupt_) {
+      Rcpp::checkUserInterrupt();
+      nextInterrupt_ = cur_ + 131072;
+    }
+
     // Increments cur on destruct, ensuring that we always move on to the
     // next character
     Advance advance(&cur_);
@@ -65,14 +154,8 @@ Token TokenizerDelim::nextToken() {
     if (*cur_ == '\0')
       hasNull = true;
 
-    if ((end_ - cur_) % 131072 == 0)
-      Rcpp::checkUserInterrupt();
-
     switch (state_) {
     case STATE_DELIM: {
-      while (cur_ != end_ && *cur_ == ' ') {
-        ++cur_;
-      }
       if (*cur_ == '\r' || *cur_ == '\n') {
         if (col_ == 0) {
           advanceForLF(&cur_, end_);
@@ -81,15 +164,15 @@ Token TokenizerDelim::nextToken() {
         }
         newRecord();
         return emptyToken(row, col);
-      } else if (isComment(cur_)) {
+      } else if (isComment<D>(cur_)) {
         state_ = STATE_COMMENT;
-      } else if (*cur_ == delim_) {
+      } else if (*cur_ == D::delim(delim_)) {
         newField();
         return emptyToken(row, col);
-      } else if (*cur_ == quote_) {
+      } else if (*cur_ == D::quote(quote_)) {
         token_begin = cur_;
         state_ = STATE_STRING;
-      } else if (escapeBackslash_ && *cur_ == '\\') {
+      } else if (D::escapeBackslash(escapeBackslash_) && *cur_ == '\\') {
         state_ = STATE_ESCAPE_F;
       } else {
         state_ = STATE_FIELD;
@@ -107,13 +190,13 @@ Token TokenizerDelim::nextToken() {
             hasNull,
             row,
             col);
-      } else if (isComment(cur_)) {
+      } else if (isComment<D>(cur_)) {
         newField();
         state_ = STATE_COMMENT;
         return fieldToken(token_begin, cur_, hasEscapeB, hasNull, row, col);
-      } else if (escapeBackslash_ && *cur_ == '\\') {
+      } else if (D::escapeBackslash(escapeBackslash_) && *cur_ == '\\') {
         state_ = STATE_ESCAPE_F;
-      } else if (*cur_ == delim_) {
+      } else if (*cur_ == D::delim(delim_)) {
         newField();
         return fieldToken(token_begin, cur_, hasEscapeB, hasNull, row, col);
       }
@@ -125,7 +208,7 @@ Token TokenizerDelim::nextToken() {
       break;
 
     case STATE_QUOTE:
-      if (*cur_ == quote_) {
+      if (*cur_ == D::quote(quote_)) {
         hasEscapeD = true;
         state_ = STATE_STRING;
       } else if (*cur_ == '\r' || *cur_ == '\n') {
@@ -138,7 +221,8 @@ Token TokenizerDelim::nextToken() {
             hasNull,
             row,
             col);
-      } else if (isComment(cur_)) {
+      } else if (isComment<D>(cur_)) {
+        newField();
         state_ = STATE_COMMENT;
         return stringToken(
             token_begin + 1,
@@ -148,7 +232,7 @@ Token TokenizerDelim::nextToken() {
             hasNull,
             row,
             col);
-      } else if (*cur_ == delim_) {
+      } else if (*cur_ == D::delim(delim_)) {
         newField();
         return stringToken(
             token_begin + 1,
@@ -165,13 +249,13 @@ Token TokenizerDelim::nextToken() {
       break;
 
     case STATE_STRING:
-      if (*cur_ == quote_) {
-        if (escapeDouble_) {
+      if (*cur_ == D::quote(quote_)) {
+        if (D::escapeDouble(escapeDouble_)) {
           state_ = STATE_QUOTE;
         } else {
           state_ = STATE_STRING_END;
         }
-      } else if (escapeBackslash_ && *cur_ == '\\') {
+      } else if (D::escapeBackslash(escapeBackslash_) && *cur_ == '\\') {
         state_ = STATE_ESCAPE_S;
       }
       break;
@@ -187,7 +271,8 @@ Token TokenizerDelim::nextToken() {
             hasNull,
             row,
             col);
-      } else if (isComment(cur_)) {
+      } else if (isComment<D>(cur_)) {
+        newField();
         state_ = STATE_COMMENT;
         return stringToken(
             token_begin + 1,
@@ -197,7 +282,7 @@ Token TokenizerDelim::nextToken() {
             hasNull,
             row,
             col);
-      } else if (*cur_ == delim_) {
+      } else if (*cur_ == D::delim(delim_)) {
         newField();
         return stringToken(
             token_begin + 1,
@@ -274,12 +359,124 @@ Token TokenizerDelim::nextToken() {
   return Token(TOKEN_EOF, row, col);
 }
 
-bool TokenizerDelim::isComment(const char* cur) const {
-  if (!hasComment_)
-    return false;
+template <> Token TokenizerDelim::scanToken<DialectUnquoted>() {
+  if (quotedNull_)
+    return scanToken<DialectGeneric>();
+
+  // Capture current position
+  int row = row_, col = col_;
+
+  if (!moreTokens_)
+    return Token(TOKEN_EOF, row, col);
+
+  if (interruptible_ && cur_ >= nextInterrupt_) {
+    Rcpp::checkUserInterrupt();
+    nextInterrupt_ = cur_ + 131072;
+  }
+
+  // Past the last kept column only the number of fields is needed, which is
+  // one more than the number of delimiters left on the line. Runs of spaces
+  // count as one delimiter when the delimiter is a space, so those are
+  // tokenized as usual.
+  if (col_ > lastKept_ && col_ > 0 && delim_ != ' ') {
+    while (true) {
+      cur_ = StructuralIndex::findDelimOrLine(cur_, end_, delim_);
+      if (cur_ == end_ || *cur_ != delim_)
+        break;
+      ++cur_;
+      ++col_;
+    }
+
+    col = col_;
+    if (cur_ == end_) {
+      moreTokens_ = false;
+    } else {
+      newRecord();
+      advanceForLF(&cur_, end_);
+      ++cur_;
+    }
+    return Token(TOKEN_EMPTY, row, col);
+  }
+
+  // Skip leading spaces and blank lines, the same way as the STATE_DELIM
+  // case of the generic loop
+  SourceIterator token_begin = cur_;
+  while (true) {
+    while (cur_ != end_ && *cur_ == ' ') {
+      ++cur_;
+    }
+
+    if (cur_ == end_) {
+      moreTokens_ = false;
+      if (col_ == 0) {
+        return Token(TOKEN_EOF, row, col);
+      } else {
+        return emptyToken(row, col);
+      }
+    }
+
+    if (*cur_ != '\r' && *cur_ != '\n')
+      break;
+
+    if (col_ > 0) {
+      ++cur_;
+      newRecord();
+      return emptyToken(row, col);
+    }
+
+    advanceForLF(&cur_, end_);
+    token_begin = ++cur_;
+  }
+
+  if (*cur_ == delim_) {
+    ++cur_;
+    newField();
+    return emptyToken(row, col);
+  }
+
+  cur_ = StructuralIndex::findDelimOrLine(cur_ + 1, end_, delim_);
+
+  if (cur_ == end_) {
+    moreTokens_ = false;
+    state_ = STATE_FIELD;
+    return fieldToken(token_begin, end_, false, false, row, col);
+  }
+
+  if (*cur_ == delim_) {
+    newField();
+    return fieldToken(token_begin, cur_++, false, false, row, col);
+  }
+
+  newRecord();
+  SourceIterator token_end = advanceForLF(&cur_, end_);
+  ++cur_;
+  return fieldToken(token_begin, token_end, false, false, row, col);
+}
+
+TokenizerPtr TokenizerDelim::clone() const {
+  return cloneAs<TokenizerDelim>();
+}
+
+bool TokenizerDelim::atRecordBoundary() const {
+  return state_ == STATE_DELIM && col_ == 0;
+}
+
+int TokenizerDelim::countRecords(
+    SourceIterator begin, SourceIterator end) const {
+  size_t n = StructuralIndex::countRecords(
+      begin, end, quote_, escapeBackslash_, comment_);
+
+  // Too many to count in an int, so let the caller read without the count
+  return n > (size_t)INT_MAX ? -1 : (int)n;
+}
+
+template <class D> bool TokenizerDelim::isComment(const char* cur) const {
+  return D::hasComment(hasComment_) && startsComment(cur, end_);
+}
 
-  boost::iterator_range<const char*> haystack(cur, end_);
-  return boost::starts_with(haystack, comment_);
+bool TokenizerDelim::startsComment(const char* cur, const char* end) const {
+  return hasComment_ && (size_t)(end - cur) >= comment_.size() &&
+         strncmp(cur, comment_.data(), comment_.size()) == 0;
 }
 
 void TokenizerDelim::newField() {
@@ -305,6 +502,9 @@ Token TokenizerDelim::fieldToken(
     int row,
     int col) {
   Token t(begin, end, row, col, hasNull, (hasEscapeB) ? this : NULL);
+  if (!isKept(col))
+    return t;
+
   if (trimWS_)
     t.trim();
   t.flagNA(NA_);
@@ -321,6 +521,9 @@ Token TokenizerDelim::stringToken(
     int col) {
   Token t(
       begin, end, row, col, hasNull, (hasEscapeD || hasEscapeB) ? this : NULL);
+  if (!isKept(col))
+    return t;
+
   if (trimWS_)
     t.trim();
   if (quotedNA_)
@@ -329,11 +532,16 @@ Token TokenizerDelim::stringToken(
 }
 
 void TokenizerDelim::unescape(
-    SourceIterator begin, SourceIterator end, boost::container::string* pOut) {
+    SourceIterator begin,
+    SourceIterator end,
+    int row,
+    int col,
+    Warnings* pWarnings,
+    boost::container::string* pOut) {
   if (escapeDouble_ && !escapeBackslash_) {
     unescapeDouble(begin, end, pOut);
   } else if (escapeBackslash_ && !escapeDouble_) {
-    unescapeBackslash(begin, end, pOut);
+    unescapeBackslash(begin, end, row, col, pWarnings, pOut);
   } else if (escapeBackslash_ && escapeDouble_) {
     Rcpp::stop("Backslash & double escapes not supported at this time");
   }
@@ -341,78 +549,106 @@ void TokenizerDelim::unescape(
 
 void TokenizerDelim::unescapeDouble(
     SourceIterator begin, SourceIterator end, boost::container::string* pOut) {
-  pOut->reserve(end - begin);
-
+  // Copy the runs between quotes whole; of each pair of quotes, the second
+  // is kept
   bool inEscape = false;
-  for (SourceIterator cur = begin; cur != end; ++cur) {
-    if (*cur == quote_) {
-      if (inEscape) {
-        pOut->push_back(*cur);
-        inEscape = false;
-      } else {
-        inEscape = true;
-      }
+  SourceIterator cur = begin;
+  while (cur != end) {
+    SourceIterator quote =
+        static_cast<SourceIterator>(memchr(cur, quote_, end - cur));
+    if (quote == NULL) {
+      pOut->append(cur, end);
+      break;
+    }
+
+    pOut->append(cur, quote);
+    if (inEscape) {
+      pOut->push_back(quote_);
+      inEscape = false;
     } else {
-      pOut->push_back(*cur);
+      inEscape = true;
     }
+    cur = quote + 1;
   }
 }
 
 void TokenizerDelim::unescapeBackslash(
-    SourceIterator begin, SourceIterator end, boost::container::string* pOut) {
-  pOut->reserve(end - begin);
+    SourceIterator begin,
+    SourceIterator end,
+    int row,
+    int col,
+    Warnings* pWarnings,
+    boost::container::string* pOut) {
+  SourceIterator cur = begin;
+  while (cur != end) {
+    SourceIterator backslash =
+        static_cast<SourceIterator>(memchr(cur, '\\', end - cur));
+    if (backslash == NULL) {
+      pOut->append(cur, end);
+      break;
+    }
 
-  bool inEscape = false;
-  for (SourceIterator cur = begin; cur != end; ++cur) {
-    if (inEscape) {
-      switch (*cur) {
-      case '\'':
-        pOut->push_back('\'');
-        break;
-      case '"':
-        pOut->push_back('"');
-        break;
-      case '\\':
-        pOut->push_back('\\');
-        break;
-      case 'a':
-        pOut->push_back('\a');
-        break;
-      case 'b':
-        pOut->push_back('\b');
-        break;
-      case 'f':
-        pOut->push_back('\f');
-        break;
-      case 'n':
-        pOut->push_back('\n');
-        break;
-      case 'r':
-        pOut->push_back('\r');
-        break;
-      case 't':
-        pOut->push_back('\t');
-        break;
-      case 'v':
-        pOut->push_back('\v');
-        break;
-      default:
-        if (*cur == delim_ || *cur == quote_ || isComment(cur)) {
-          pOut->push_back(*cur);
-        } else {
-          pOut->push_back('\\');
-          pOut->push_back(*cur);
-          warn(row_, col_, "standard escape", "\\" + std::string(cur, 1));
-        }
-        break;
-      }
-      inEscape = false;
-    } else {
-      if (*cur == '\\') {
-        inEscape = true;
+    pOut->append(cur, backslash);
+    cur = backslash + 1;
+    if (cur == end)
+      break;
+
+    switch (*cur) {
+    case '\'':
+      pOut->push_back('\'');
+      break;
+    case '"':
+      pOut->push_back('"');
+      break;
+    case '\\':
+      pOut->push_back('\\');
+      break;
+    case 'a':
+      pOut->push_back('\a');
+      break;
+    case 'b':
+      pOut->push_back('\b');
+      break;
+    case 'f':
+      pOut->push_back('\f');
+      break;
+    case 'n':
+      pOut->push_back('\n');
+      break;
+    case 'r':
+      pOut->push_back('\r');
+      break;
+    case 't':
+      pOut->push_back('\t');
+      break;
+    case 'v':
+      pOut->push_back('\v');
+      break;
+    default:
+      if (*cur == delim_ || *cur == quote_ || startsComment(cur, end)) {
+        pOut->push_back(*cur);
       } else {
+        pOut->push_back('\\');
         pOut->push_back(*cur);
+        if (pWarnings != NULL) {
+          pWarnings->addWarning(
+              row, col, "standard escape", "\\" + std::string(cur, 1));
+        }
       }
+      break;
     }
+    ++cur;
   }
 }
+
+// The specialised tokenizers created by Tokenizer::create()
+template void TokenizerDelim::fillBatch<DialectCsv>(
+    TokenBatch*, int, int);
+template void TokenizerDelim::fillBatch<DialectCsv2>(
+    TokenBatch*, int, int);
+template void TokenizerDelim::fillBatch<DialectTsv>(
+    TokenBatch*, int, int);
+template void TokenizerDelim::fillBatch<DialectPipe>(
+    TokenBatch*, int, int);
+template void TokenizerDelim::fillBatch<DialectUnquoted>(
+    TokenBatch*, int, int);
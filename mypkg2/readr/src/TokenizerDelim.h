@@ -1,7 +1,9 @@
 #ifndef FASTREAD_TOKENIZEDELIM_H_
 #define FASTREAD_TOKENIZEDELIM_H_
 
+#include "StructuralIndex.h"
 #include "Token.h"
+#include "TokenBatch.h"
 #include "Tokenizer.h"
 #include "utils.h"
 #include <Rcpp.h>
@@ -17,18 +19,63 @@ enum DelimState {
   STATE_COMMENT
 };
 
+// A dialect fixes some of the settings of TokenizerDelim at compile time,
+// so that the tokenizer loop does not test them on every byte.
+// DialectGeneric fixes nothing: each setting is the run time value passed in.
+struct DialectGeneric {
+  static char delim(char x) { return x; }
+  static char quote(char x) { return x; }
+  static bool escapeBackslash(bool x) { return x; }
+  static bool escapeDouble(bool x) { return x; }
+  static bool hasComment(bool x) { return x; }
+};
+
+// A format with the given delimiter and quote, where quotes are escaped by
+// doubling them, and with no backslash escapes or comments
+template <char Delim, char Quote> struct Dialect {
+  static char delim(char) { return Delim; }
+  static char quote(char) { return Quote; }
+  static bool escapeBackslash(bool) { return false; }
+  static bool escapeDouble(bool) { return true; }
+  static bool hasComment(bool) { return false; }
+};
+
+typedef Dialect<',', '"'> DialectCsv;
+typedef Dialect<';', '"'> DialectCsv2;
+typedef Dialect<'\t', '"'> DialectTsv;
+typedef Dialect<'|', '"'> DialectPipe;
+
+// A format with any delimiter but no quotes, escapes or comments. Fields
+// then end at the first delimiter or line ending, so the tokenizer has a
+// separate loop for it that searches for those directly.
+struct DialectUnquoted : public DialectGeneric {
+  static char quote(char) { return '\0'; }
+  static bool escapeBackslash(bool) { return false; }
+  static bool hasComment(bool) { return false; }
+};
+
 class TokenizerDelim : public Tokenizer {
   char delim_, quote_;
-  std::vector<std::string> NA_;
+  NaMatcher NA_;
   std::string comment_;
 
   bool hasComment_, trimWS_, escapeBackslash_, escapeDouble_, quotedNA_,
       hasEmptyNA_;
 
-  SourceIterator begin_, cur_, end_;
+  // Whether the input contains a null while the quote is also null (no
+  // quote). Each null then starts a quoted string, which the loop for
+  // DialectUnquoted does not handle.
+  bool quotedNull_;
+
+  SourceIterator begin_, cur_, end_, nextInterrupt_;
+  StructuralIndex index_;
   DelimState state_;
   int row_, col_;
-  bool moreTokens_;
+  bool moreTokens_, interruptible_;
+
+  // Tokens already read, but not yet returned by nextToken()
+  TokenBatch batch_;
+  size_t batchPos_;
 
 public:
   TokenizerDelim(
@@ -47,11 +94,42 @@ public:
 
   Token nextToken();
 
+  void nextBatch(TokenBatch* pBatch, int maxRows, int endRow = INT_MAX);
+
+  TokenizerPtr clone() const;
+  bool canClone() const { return true; }
+
+  bool atRecordBoundary() const;
+
+  int countRecords(SourceIterator begin, SourceIterator end) const;
+
   void unescape(
-      SourceIterator begin, SourceIterator end, boost::container::string* pOut);
+      SourceIterator begin,
+      SourceIterator end,
+      int row,
+      int col,
+      Warnings* pWarnings,
+      boost::container::string* pOut);
+
+protected:
+  // Defined in TokenizerDelim.cpp for DialectGeneric and the dialects above
+  template <class D>
+  void fillBatch(TokenBatch* pBatch, int maxRows, int endRow);
+
+  template <class T> TokenizerPtr cloneAs() const {
+    T* out = new T(static_cast<const T&>(*this));
+    out->interruptible_ = false;
+    return TokenizerPtr(out);
+  }
 
 private:
-  bool isComment(const char* cur) const;
+  template <class D> Token scanToken();
+
+  template <class D> bool isComment(const char* cur) const;
+
+  // Whether the comment starts at cur and ends by end. Unescaping uses the
+  // end of the field, as the tokenizer may not have read the input.
+  bool startsComment(const char* cur, const char* end) const;
 
   void newField();
 
@@ -77,9 +155,27 @@ private:
       int col);
 
   void unescapeBackslash(
-      SourceIterator begin, SourceIterator end, boost::container::string* pOut);
+      SourceIterator begin,
+      SourceIterator end,
+      int row,
+      int col,
+      Warnings* pWarnings,
+      boost::container::string* pOut);
 
   void unescapeDouble(
       SourceIterator begin, SourceIterator end, boost::container::string* pOut);
 };
+
+// TokenizerDelim specialised for a Dialect
+template <class D> class TokenizerDelimDialect : public TokenizerDelim {
+public:
+  TokenizerDelimDialect(const TokenizerDelim& tokenizer)
+      : TokenizerDelim(tokenizer) {}
+
+  void nextBatch(TokenBatch* pBatch, int maxRows, int endRow = INT_MAX) {
+    fillBatch<D>(pBatch, maxRows, endRow);
+  }
+
+  TokenizerPtr clone() const { return cloneAs<TokenizerDelimDialect<D> >(); }
+};
 #endif
@@ -6,6 +6,8 @@ using namespace Rcpp;
 #include "TokenizerFwf.h"
 #include "utils.h"
 
+#include <string.h>
+
 struct skip_t {
   SourceIterator begin;
   int lines;
@@ -156,15 +158,14 @@ TokenizerFwf::TokenizerFwf(
 }
 
 void TokenizerFwf::tokenize(SourceIterator begin, SourceIterator end) {
-  cur_ = begin;
-  curLine_ = begin;
-
   begin_ = begin;
   end_ = end;
 
   row_ = 0;
   col_ = 0;
   moreTokens_ = true;
+
+  newLine(begin, false);
 }
 
 std::pair<double, size_t> TokenizerFwf::progress() {
@@ -172,115 +173,168 @@ std::pair<double, size_t> TokenizerFwf::progress() {
   return std::make_pair(bytes / (double)(end_ - begin_), bytes);
 }
 
+// Fields are located from their offsets and the length of the line, which is
+// found once per line, so no byte of a line is visited more than once (or at
+// all, in the fields of skipped columns).
 Token TokenizerFwf::nextToken() {
   if (!moreTokens_)
     return Token(TOKEN_EOF, 0, 0);
 
   // Check for comments only at start of line
-  while (cur_ != end_ && col_ == 0 && (isComment(cur_) || isEmpty())) {
-    // Skip rest of line
-    while (cur_ != end_ && *cur_ != '\n' && *cur_ != '\r') {
-      ++cur_;
-    }
-    advanceForLF(&cur_, end_);
-    if (cur_ != end_) {
-      ++cur_;
-    }
-    curLine_ = cur_;
+  while (cur_ != end_ && col_ == 0 && !lineChecked_ &&
+         (isComment(cur_) || isEmpty())) {
+    nextLine(false);
   }
+  lineChecked_ = true;
 
-  // Find start of field
-  SourceIterator fieldBegin = cur_;
-findBeginning:
-  int skip = beginOffset_[col_] - (cur_ - curLine_);
-  if (skip < 0) { // overlapping case
-    fieldBegin += skip;
-  } else if (skip > 0) { // skipped columns case
-    for (int i = 0; i < skip; ++i) {
-      if (fieldBegin == end_)
-        break;
+  if (col_ > 0 && col_ > lastKept_)
+    return skipRecord();
 
-      if (*fieldBegin == '\n' || *fieldBegin == '\r') {
-        warn(
-            row_,
-            col_,
-            tfm::format("%i chars between fields", skip),
-            tfm::format("%i chars until end of line", i));
-
-        row_++;
-        col_ = 0;
-
-        advanceForLF(&fieldBegin, end_);
-        if (fieldBegin != end_)
-          fieldBegin++;
-        cur_ = curLine_ = fieldBegin;
-        goto findBeginning;
-      }
-      fieldBegin++;
+  // Find start of field
+  int lineLength = lineEnd_ - curLine_;
+  while (beginOffset_[col_] > lineLength) {
+    if (lineEnd_ == end_) {
+      // need to warn here if col != 0/cols - 1
+      moreTokens_ = false;
+      return Token(TOKEN_EOF, 0, 0);
     }
+
+    int pos = cur_ - curLine_;
+    warn(
+        row_,
+        col_,
+        tfm::format("%i chars between fields", beginOffset_[col_] - pos),
+        tfm::format("%i chars until end of line", lineLength - pos));
+
+    // The rest of the fields are read from the next line, even if it is a
+    // comment or empty
+    row_++;
+    col_ = 0;
+    nextLine(true);
+    lineLength = lineEnd_ - curLine_;
   }
 
+  SourceIterator fieldBegin = curLine_ + beginOffset_[col_];
   if (fieldBegin == end_) {
-    // need to warn here if col != 0/cols - 1
     moreTokens_ = false;
     return Token(TOKEN_EOF, 0, 0);
   }
 
   // Find end of field
-  SourceIterator fieldEnd = fieldBegin;
-  bool lastCol = (col_ == cols_ - 1), tooShort = false, hasNull = false;
+  SourceIterator fieldEnd;
+  bool lastCol = (col_ == cols_ - 1), tooShort = false;
 
   if (lastCol && isRagged_) {
     // Last column is ragged, so read until end of line (ignoring width)
-    while (fieldEnd != end_ && *fieldEnd != '\r' && *fieldEnd != '\n') {
-      if (*fieldEnd == '\0')
-        hasNull = true;
-      fieldEnd++;
-    }
-  } else {
+    fieldEnd = lineEnd_;
+  } else if (endOffset_[col_] > lineLength) {
     int width = endOffset_[col_] - beginOffset_[col_];
-    // Find the end of the field, stopping for newlines
-    for (int i = 0; i < width; ++i) {
-      if (fieldEnd == end_ || *fieldEnd == '\n' || *fieldEnd == '\r') {
-        warn(row_, col_, tfm::format("%i chars", width), tfm::format("%i", i));
-
-        tooShort = true;
-        break;
-      }
-      if (*fieldEnd == '\0')
-        hasNull = true;
-
-      fieldEnd++;
-    }
+    warn(
+        row_,
+        col_,
+        tfm::format("%i chars", width),
+        tfm::format("%i", lineLength - beginOffset_[col_]));
+
+    tooShort = true;
+    fieldEnd = lineEnd_;
+  } else {
+    fieldEnd = curLine_ + endOffset_[col_];
   }
 
+  bool hasNull = isKept(col_) &&
+                 memchr(fieldBegin, '\0', fieldEnd - fieldBegin) != NULL;
   Token t = fieldToken(fieldBegin, fieldEnd, hasNull);
 
   if (lastCol || tooShort) {
+    // Proceed to the end of the line when you are possibly not there.
+    // This is needed in case the last column in the file is not being read.
     row_++;
     col_ = 0;
+    nextLine(false);
+  } else {
+    col_++;
+    cur_ = fieldEnd;
+  }
+
+  return t;
+}
 
-    if (!(tooShort || isRagged_)) {
-      // Proceed to the end of the line when you are possibly not there.
-      // This is needed in case the last column in the file is not being read.
-      while (fieldEnd != end_ && *fieldEnd != '\r' && *fieldEnd != '\n') {
-        if (*fieldEnd == '\0')
-          hasNull = true;
-        fieldEnd++;
+// Moves past the columns after the last kept column, giving the same problems
+// as reading them would. Returns a token for the last field of the record, or
+// the end of the input if the record has ended already.
+Token TokenizerFwf::skipRecord() {
+  int row = row_, lastCol = -1;
+  int lineLength = lineEnd_ - curLine_;
+
+  while (true) {
+    if (beginOffset_[col_] > lineLength) {
+      if (lineEnd_ == end_) {
+        moreTokens_ = false;
+        break;
       }
+
+      int pos = cur_ - curLine_;
+      warn(
+          row_,
+          col_,
+          tfm::format("%i chars between fields", beginOffset_[col_] - pos),
+          tfm::format("%i chars until end of line", lineLength - pos));
+
+      row_++;
+      col_ = 0;
+      nextLine(true);
+      break;
     }
 
-    curLine_ = fieldEnd;
-    advanceForLF(&curLine_, end_);
-    if (curLine_ != end_)
-      curLine_++;
-    cur_ = curLine_;
-  } else {
+    SourceIterator fieldBegin = curLine_ + beginOffset_[col_];
+    if (fieldBegin == end_) {
+      moreTokens_ = false;
+      break;
+    }
+
+    lastCol = col_;
+    bool last = (col_ == cols_ - 1), tooShort = false;
+
+    if (!(last && isRagged_) && endOffset_[col_] > lineLength) {
+      int width = endOffset_[col_] - beginOffset_[col_];
+      warn(
+          row_,
+          col_,
+          tfm::format("%i chars", width),
+          tfm::format("%i", lineLength - beginOffset_[col_]));
+      tooShort = true;
+    }
+
+    if (last || tooShort) {
+      row_++;
+      col_ = 0;
+      nextLine(false);
+      break;
+    }
+
+    cur_ = curLine_ + endOffset_[col_];
     col_++;
-    cur_ = fieldEnd;
   }
 
-  return t;
+  if (lastCol == -1)
+    return moreTokens_ ? nextToken() : Token(TOKEN_EOF, 0, 0);
+
+  return Token(TOKEN_EMPTY, row, lastCol);
+}
+
+void TokenizerFwf::newLine(SourceIterator begin, bool checked) {
+  cur_ = curLine_ = begin;
+  lineEnd_ = StructuralIndex::findLine(begin, end_);
+  lineChecked_ = checked;
+}
+
+// Moves to the start of the line after the current one
+void TokenizerFwf::nextLine(bool checked) {
+  SourceIterator next = lineEnd_;
+  advanceForLF(&next, end_);
+  if (next != end_)
+    next++;
+  newLine(next, checked);
 }
 
 Token TokenizerFwf::fieldToken(
@@ -289,6 +343,9 @@ Token TokenizerFwf::fieldToken(
     return Token(TOKEN_MISSING, row_, col_);
 
   Token t = Token(begin, end, row_, col_, hasNull);
+  if (!isKept(col_))
+    return t;
+
   if (trimWS_) {
     t.trim();
   }
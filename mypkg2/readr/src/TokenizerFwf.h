@@ -1,6 +1,7 @@
 #ifndef FASTREAD_TOKENIZERFWF_H_
 #define FASTREAD_TOKENIZERFWF_H_
 
+#include "StructuralIndex.h"
 #include "Token.h"
 #include "Tokenizer.h"
 #include "utils.h"
@@ -8,13 +9,16 @@
 
 class TokenizerFwf : public Tokenizer {
   std::vector<int> beginOffset_, endOffset_;
-  std::vector<std::string> NA_;
+  NaMatcher NA_;
 
-  SourceIterator begin_, cur_, curLine_, end_;
+  SourceIterator begin_, cur_, curLine_, lineEnd_, end_;
   int row_, col_, cols_, max_;
   std::string comment_;
   bool moreTokens_, isRagged_, hasComment_, trimWS_;
 
+  // Whether the current line is known not to be a comment or empty line
+  bool lineChecked_;
+
 public:
   TokenizerFwf(
       const std::vector<int>& beginOffset,
@@ -30,6 +34,11 @@ public:
   Token nextToken();
 
 private:
+  Token skipRecord();
+
+  void newLine(SourceIterator begin, bool checked);
+  void nextLine(bool checked);
+
   Token fieldToken(SourceIterator begin, SourceIterator end, bool hasNull);
 
   bool isComment(const char* cur) const;
@@ -8,7 +8,7 @@
 
 class TokenizerLine : public Tokenizer {
   SourceIterator begin_, cur_, end_;
-  std::vector<std::string> NA_;
+  NaMatcher NA_;
   bool moreTokens_;
   int line_;
 
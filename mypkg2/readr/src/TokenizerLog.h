@@ -20,9 +20,10 @@ class TokenizerLog : public Tokenizer {
   LogState state_;
   int row_, col_;
   bool moreTokens_;
+  NaMatcher NA_;
 
 public:
-  TokenizerLog() {}
+  TokenizerLog() : NA_(std::vector<std::string>(1, "-")) {}
 
   void tokenize(SourceIterator begin, SourceIterator end) {
     cur_ = begin;
@@ -164,8 +165,7 @@ private:
   }
 
   Token fieldToken(SourceIterator begin, SourceIterator end, int row, int col) {
-    return Token(begin, end, row, col, false)
-        .flagNA(std::vector<std::string>(1, "-"));
+    return Token(begin, end, row, col, false).flagNA(NA_);
   }
 };
 
@@ -0,0 +1,189 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "TokenizerParallel.h"
+
+#include <limits.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void TokenizerChunk::tokenize(
+    const Tokenizer& prototype, SourceIterator sourceEnd) {
+  TokenizerPtr tokenizer = prototype.clone();
+  tokens.reset();
+  warnings.clear();
+
+  tokenizer->setWarnings(&warnings);
+  tokenizer->tokenize(begin, end);
+  tokenizer->nextBatch(&tokens, INT_MAX);
+
+  complete = end == sourceEnd || tokenizer->atRecordBoundary();
+}
+
+TokenizerParallel::TokenizerParallel(
+    TokenizerPtr prototype, int numThreads, size_t chunkSize)
+    : prototype_(prototype),
+      numThreads_(numThreads),
+      chunkSize_(chunkSize),
+      nChunks_(0),
+      chunk_(0),
+      token_(0),
+      rows_(0) {
+  if (numThreads_ < 1)
+    Rcpp::stop("`num_threads` must be at least 1");
+  if (chunkSize_ < 1)
+    Rcpp::stop("Chunk size must be at least 1");
+}
+
+void TokenizerParallel::tokenize(SourceIterator begin, SourceIterator end) {
+  begin_ = begin;
+  end_ = end;
+  pos_ = begin;
+
+  nChunks_ = 0;
+  chunk_ = 0;
+  token_ = 0;
+  rows_ = 0;
+}
+
+std::pair<double, size_t> TokenizerParallel::progress() {
+  SourceIterator cur = (chunk_ < nChunks_) ? chunks_[chunk_].end : pos_;
+  size_t bytes = cur - begin_;
+  return std::make_pair(bytes / (double)(end_ - begin_), bytes);
+}
+
+Token TokenizerParallel::nextToken() {
+  if (!nextChunk())
+    return Token(TOKEN_EOF, rows_, 0);
+
+  return chunks_[chunk_].tokens.token(token_++);
+}
+
+void TokenizerParallel::nextBatch(
+    TokenBatch* pBatch, int maxRows, int endRow) {
+  pBatch->clear();
+
+  // The pending token is only a marker, the token itself is still the next
+  // one in its chunk
+  if (pBatch->hasPending())
+    pBatch->takePending();
+
+  int firstRow = 0;
+  while (nextChunk()) {
+    const TokenBatch& tokens = chunks_[chunk_].tokens;
+    int row = tokens.row(token_);
+
+    if (pBatch->empty()) {
+      firstRow = row;
+    }
+    if (row - firstRow >= maxRows || row >= endRow) {
+      pBatch->setPending(tokens.token(token_));
+      return;
+    }
+
+    pBatch->push_back(tokens, token_++);
+  }
+}
+
+void TokenizerParallel::setKeptColumns(const std::vector<bool>& keep) {
+  Tokenizer::setKeptColumns(keep);
+  prototype_->setKeptColumns(keep);
+}
+
+// Moves on to the next chunk with unread tokens, tokenizing more of the input
+// if needed. Returns false at the end of the input.
+bool TokenizerParallel::nextChunk() {
+  while (chunk_ == nChunks_ || token_ == chunks_[chunk_].tokens.size()) {
+    if (chunk_ + 1 < nChunks_) {
+      chunk_++;
+      token_ = 0;
+      continue;
+    }
+
+    if (pos_ == end_)
+      return false;
+
+    Rcpp::checkUserInterrupt();
+    tokenizeRound();
+  }
+
+  return true;
+}
+
+void TokenizerParallel::tokenizeRound() {
+  prototype_->setWarnings(pWarnings_);
+
+  // The chunks are reused from round to round, so that their token buffers
+  // only need to grow once
+  std::vector<TokenizerChunk>& chunks = chunks_;
+  chunks.resize(numThreads_);
+
+  // Guess that the line endings following each split point are outside of
+  // quoted fields
+  int n = 0;
+  for (SourceIterator cur = pos_; n < numThreads_ && cur != end_; ++n) {
+    chunks[n].begin = cur;
+    chunks[n].end = nextLine(
+        (size_t)(end_ - cur) > chunkSize_ ? cur + chunkSize_ : end_);
+    cur = chunks[n].end;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic)
+#endif
+  for (int i = 0; i < n; ++i) {
+    chunks[i].tokenize(*prototype_, end_);
+  }
+
+  // Check the guesses. The first chunk starts on a record boundary, so each
+  // chunk that ends on one means the next chunk was tokenized correctly.
+  int accepted = 0;
+  for (; accepted < n; ++accepted) {
+    TokenizerChunk& chunk = chunks[accepted];
+
+    if (!chunk.complete) {
+      // The guess was wrong, so the chunk ended inside a quoted field. Extend
+      // it until it ends on a record boundary; the chunks after it started
+      // in the wrong state and are read again in the next round.
+      size_t extra = chunkSize_;
+      while (!chunk.complete) {
+        chunk.end = nextLine(
+            (size_t)(end_ - chunk.end) > extra ? chunk.end + extra : end_);
+        chunk.tokenize(*prototype_, end_);
+        extra *= 2;
+      }
+      accept(chunk);
+      accepted++;
+      break;
+    }
+
+    accept(chunk);
+  }
+
+  pos_ = chunks[accepted - 1].end;
+  nChunks_ = accepted;
+  chunk_ = 0;
+  token_ = 0;
+}
+
+void TokenizerParallel::accept(TokenizerChunk& chunk) {
+  chunk.tokens.offsetRows(rows_);
+
+  if (pWarnings_ != NULL) {
+    pWarnings_->append(chunk.warnings, rows_);
+  }
+
+  // The tokenizer that read the chunk is gone, so unescape with the
+  // prototype
+  chunk.tokens.setTokenizer(prototype_.get());
+
+  if (!chunk.tokens.empty()) {
+    rows_ = chunk.tokens.row(chunk.tokens.size() - 1) + 1;
+  }
+}
+
+SourceIterator TokenizerParallel::nextLine(SourceIterator cur) const {
+  return nextLineStart(cur, end_);
+}
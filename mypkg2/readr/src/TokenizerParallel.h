@@ -0,0 +1,72 @@
+#ifndef FASTREAD_TOKENIZERPARALLEL_H_
+#define FASTREAD_TOKENIZERPARALLEL_H_
+
+#include "Token.h"
+#include "TokenBatch.h"
+#include "Tokenizer.h"
+#include "Warnings.h"
+#include "utils.h"
+#include <Rcpp.h>
+
+// A contiguous byte range of the input, tokenized on its own
+struct TokenizerChunk {
+  SourceIterator begin, end;
+  TokenBatch tokens;
+  Warnings warnings;
+  bool complete;
+
+  TokenizerChunk() : begin(NULL), end(NULL), complete(false) {}
+
+  void tokenize(const Tokenizer& prototype, SourceIterator sourceEnd);
+};
+
+// Tokenizes the input on several threads and returns the tokens in the same
+// order, with the same rows, as the wrapped tokenizer would.
+//
+// The input is processed in rounds. Each round splits the next
+// numThreads * chunkSize bytes into chunks at line endings, guessing that
+// none of the split points fall inside a quoted field, and tokenizes the
+// chunks in parallel. The guesses are then checked in order: a chunk that
+// does not end on a record boundary is rescanned with a later end, and the
+// chunks after it are discarded and read again in the next round.
+class TokenizerParallel : public Tokenizer {
+  TokenizerPtr prototype_;
+  int numThreads_;
+  size_t chunkSize_;
+
+  SourceIterator begin_, end_, pos_;
+
+  std::vector<TokenizerChunk> chunks_;
+  size_t nChunks_, chunk_, token_;
+  int rows_;
+
+public:
+  TokenizerParallel(
+      TokenizerPtr prototype, int numThreads, size_t chunkSize = 1048576);
+
+  void tokenize(SourceIterator begin, SourceIterator end);
+
+  std::pair<double, size_t> progress();
+
+  Token nextToken();
+
+  void nextBatch(TokenBatch* pBatch, int maxRows, int endRow = INT_MAX);
+
+  void setKeptColumns(const std::vector<bool>& keep);
+
+  int countRecords(SourceIterator begin, SourceIterator end) const {
+    return prototype_->countRecords(begin, end);
+  }
+
+private:
+  bool nextChunk();
+
+  void tokenizeRound();
+
+  void accept(TokenizerChunk& chunk);
+
+  // Start of the line following cur, or the end of the input
+  SourceIterator nextLine(SourceIterator cur) const;
+};
+
+#endif
@@ -45,6 +45,9 @@ Token TokenizerWs::nextToken() {
   if (cur_ == end_)
     return Token(TOKEN_EOF, 0, 0);
 
+  if (col_ > 0 && col_ > lastKept_)
+    return skipRecord();
+
   // Find start of field
   SourceIterator fieldBegin = cur_;
   while (fieldBegin != end_ && isblank(*fieldBegin)) {
@@ -76,12 +79,57 @@ Token TokenizerWs::nextToken() {
   return t;
 }
 
+// Moves past the fields after the last kept column without making tokens for
+// them. Returns a token for the last field of the record, so the number of
+// columns is still known, or the next token if the record has ended already.
+Token TokenizerWs::skipRecord() {
+  int row = row_, lastCol = -1;
+
+  while (cur_ != end_) {
+    SourceIterator fieldBegin = cur_;
+    while (fieldBegin != end_ && isblank(*fieldBegin)) {
+      ++fieldBegin;
+    }
+
+    if (isComment(fieldBegin)) {
+      ignoreLine();
+      row_++;
+      col_ = 0;
+      break;
+    }
+
+    SourceIterator fieldEnd = fieldBegin;
+    while (fieldEnd != end_ && !isspace(*fieldEnd)) {
+      ++fieldEnd;
+    }
+
+    lastCol = col_;
+    cur_ = fieldEnd;
+    ++col_;
+    if (cur_ != end_ && (*cur_ == '\r' || *cur_ == '\n')) {
+      advanceForLF(&cur_, end_);
+      ++cur_;
+      row_++;
+      col_ = 0;
+      break;
+    }
+  }
+
+  if (lastCol == -1)
+    return nextToken();
+
+  return Token(TOKEN_EMPTY, row, lastCol);
+}
+
 Token TokenizerWs::fieldToken(
     SourceIterator begin, SourceIterator end, bool hasNull) {
   if (begin == end)
     return Token(TOKEN_MISSING, row_, col_);
 
   Token t = Token(begin, end, row_, col_, hasNull);
+  if (!isKept(col_))
+    return t;
+
   t.trim();
   t.flagNA(NA_);
 
@@ -7,7 +7,7 @@
 #include <Rcpp.h>
 
 class TokenizerWs : public Tokenizer {
-  std::vector<std::string> NA_;
+  NaMatcher NA_;
 
   SourceIterator begin_, cur_, curLine_, end_;
   int row_, col_;
@@ -26,6 +26,7 @@ public:
   Token nextToken();
 
 private:
+  Token skipRecord();
   Token fieldToken(SourceIterator begin, SourceIterator end, bool hasNull);
 
   bool isComment(const char* cur) const;
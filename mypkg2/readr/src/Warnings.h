@@ -1,12 +1,92 @@
 #ifndef READ_WARNINGS_H_
 #define READ_WARNINGS_H_
 
+#include <algorithm>
+#include <climits>
+#include <string.h>
+
 class Warnings {
-  std::vector<int> row_, col_;
-  std::vector<std::string> expected_, actual_;
+  // One record per problem. expected indexes messages_. The actual text is
+  // texts_[text], or the slice of the input from begin if text is -1, which
+  // is only read by asDataFrame().
+  struct Problem {
+    int row, col, expected, text;
+    const char* begin;
+    int length;
+
+    bool operator<(const Problem& other) const { return row < other.row; }
+  };
+  std::vector<Problem> problems_;
+
+  // Interned expected messages, of which there are only a few, and the
+  // actual text of problems that is not part of the input
+  std::vector<std::string> messages_;
+  std::vector<std::string> texts_;
+  int lastMessage_;
+
+  // At most maxProblems_ problems are kept, but all are counted, by column;
+  // counts_[0] is for problems without a column
+  size_t maxProblems_;
+  std::vector<int> counts_;
+  int total_;
+
+  int message(const char* expected, size_t n) {
+    if (lastMessage_ >= 0 && messages_[lastMessage_].size() == n &&
+        memcmp(messages_[lastMessage_].data(), expected, n) == 0)
+      return lastMessage_;
+
+    for (size_t i = 0; i < messages_.size(); ++i) {
+      if (messages_[i].size() == n &&
+          memcmp(messages_[i].data(), expected, n) == 0)
+        return lastMessage_ = i;
+    }
+    messages_.push_back(std::string(expected, n));
+    return lastMessage_ = messages_.size() - 1;
+  }
+
+  void count(int col, int n) {
+    size_t k = (col == NA_INTEGER) ? 0 : col;
+    if (k >= counts_.size())
+      counts_.resize(k + 1, 0);
+    counts_[k] += n;
+    total_ += n;
+  }
+
+  // Whether another problem can be kept
+  bool room() const { return problems_.size() < maxProblems_; }
+
+  // Keeps p, a problem of from, without counting it
+  void keep(const Warnings& from, Problem p) {
+    if (!room())
+      return;
+
+    const std::string& expected = from.messages_[p.expected];
+    p.expected = message(expected.data(), expected.size());
+    if (p.text >= 0) {
+      texts_.push_back(from.texts_[p.text]);
+      p.text = texts_.size() - 1;
+    }
+    problems_.push_back(p);
+  }
+
+  void add(int row, int col, const char* expected, size_t n) {
+    row = (row == -1) ? NA_INTEGER : row + 1;
+    col = (col == -1) ? NA_INTEGER : col + 1;
+    count(col, 1);
+
+    Problem p;
+    p.row = row;
+    p.col = col;
+    p.expected = message(expected, n);
+    p.text = -1;
+    p.begin = NULL;
+    p.length = 0;
+    problems_.push_back(p);
+  }
 
 public:
-  Warnings() {}
+  Warnings()
+      : lastMessage_(-1), maxProblems_((size_t)INT_MAX), total_(0) {}
 
   // row and col should be zero-indexed. addWarning converts into one-indexed
   void addWarning(
@@ -14,41 +94,190 @@ public:
       int col,
       const std::string& expected,
       const std::string& actual) {
-    row_.push_back(row == -1 ? NA_INTEGER : row + 1);
-    col_.push_back(col == -1 ? NA_INTEGER : col + 1);
-    expected_.push_back(expected);
-    actual_.push_back(actual);
+    if (!room()) {
+      count(col == -1 ? NA_INTEGER : col + 1, 1);
+      return;
+    }
+
+    add(row, col, expected.data(), expected.size());
+    texts_.push_back(actual);
+    problems_.back().text = texts_.size() - 1;
+  }
+
+  // Like addWarning(), but the actual text is the input from begin to end,
+  // which must not change or be released before asDataFrame() is called,
+  // or copyInput() is
+  void addWarning(
+      int row,
+      int col,
+      const char* expected,
+      const char* begin,
+      const char* end) {
+    if (!room()) {
+      count(col == -1 ? NA_INTEGER : col + 1, 1);
+      return;
+    }
+
+    add(row, col, expected, strlen(expected));
+    problems_.back().begin = begin;
+    problems_.back().length = end - begin;
+  }
+
+  // Keep at most n problems, though all are counted
+  void setMaxProblems(size_t n) { maxProblems_ = n; }
+
+  // Copies the actual text of the problems that is part of the input, so
+  // the input can be released
+  void copyInput() {
+    for (size_t i = 0; i < problems_.size(); ++i) {
+      Problem& p = problems_[i];
+      if (p.text == -1) {
+        texts_.push_back(std::string(p.begin, p.begin + p.length));
+        p.text = texts_.size() - 1;
+      }
+    }
+  }
+
+  // Append the warnings from other, shifting their rows down by rowOffset
+  void append(const Warnings& other, int rowOffset) {
+    for (size_t i = 0; i < other.problems_.size(); ++i) {
+      Problem p = other.problems_[i];
+      if (p.row != NA_INTEGER)
+        p.row += rowOffset;
+      keep(other, p);
+    }
+
+    for (size_t k = 0; k < other.counts_.size(); ++k) {
+      if (other.counts_[k] > 0)
+        count(k == 0 ? NA_INTEGER : k, other.counts_[k]);
+    }
+  }
+
+  // Stable sort the warnings from begin onwards by row
+  void sortRows(size_t begin) {
+    size_t n = problems_.size();
+    if (n - begin < 2)
+      return;
+
+    bool sorted = true;
+    for (size_t i = begin + 1; i < n && sorted; ++i) {
+      sorted = problems_[i - 1].row <= problems_[i].row;
+    }
+    if (sorted)
+      return;
+
+    std::stable_sort(problems_.begin() + begin, problems_.end());
+  }
+
+  // Move the warnings from begin onwards for the rows from firstRow to
+  // rows[row - firstRow], dropping those moved to -1. Warnings for earlier
+  // rows are dropped, and those for later rows are moved into pLater.
+  // Problems past the maximum that were counted but not kept have no row to
+  // move, so their counts are only exact if none were.
+  void remapRows(
+      size_t begin,
+      int firstRow,
+      const std::vector<int>& rows,
+      Warnings* pLater) {
+    size_t out = begin;
+    for (size_t i = begin; i < problems_.size(); ++i) {
+      Problem p = problems_[i];
+      if (p.row != NA_INTEGER) {
+        int k = p.row - 1 - firstRow;
+        if (k >= (int)rows.size()) {
+          pLater->keep(*this, p);
+          pLater->count(p.col, 1);
+          count(p.col, -1);
+          continue;
+        }
+        if (k < 0 || rows[k] == -1) {
+          count(p.col, -1);
+          continue;
+        }
+        p.row = rows[k] + 1;
+      }
+
+      problems_[out++] = p;
+    }
+
+    problems_.resize(out);
   }
 
   Rcpp::RObject addAsAttribute(Rcpp::RObject x) {
-    if (size() == 0)
+    if (total() == 0)
       return x;
 
     x.attr("problems") = asDataFrame();
     return x;
   }
 
-  size_t size() { return row_.size(); }
+  // The number of problems kept, and the number found
+  size_t size() { return problems_.size(); }
+  int total() const { return total_; }
 
   void clear() {
-    row_.clear();
-    col_.clear();
-    expected_.clear();
-    actual_.clear();
+    problems_.clear();
+    messages_.clear();
+    texts_.clear();
+    lastMessage_ = -1;
+    counts_.clear();
+    total_ = 0;
   }
 
+  // The problems kept. If some were only counted, the number found is the
+  // "n" attribute, and the number in each column the "col_counts" attribute.
   Rcpp::List asDataFrame() {
+    size_t n = problems_.size();
+    Rcpp::IntegerVector row(n), col(n);
+    Rcpp::CharacterVector expected(n), actual(n);
+
+    Rcpp::CharacterVector messages(messages_.size());
+    for (size_t i = 0; i < messages_.size(); ++i) {
+      messages[i] = messages_[i];
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      const Problem& p = problems_[i];
+      row[i] = p.row;
+      col[i] = p.col;
+      SET_STRING_ELT(expected, i, STRING_ELT(messages, p.expected));
+      if (p.text >= 0) {
+        actual[i] = texts_[p.text];
+      } else {
+        actual[i] = std::string(p.begin, p.begin + p.length);
+      }
+    }
+
     Rcpp::List out = Rcpp::List::create(
-        Rcpp::_["row"] = Rcpp::wrap(row_),
-        Rcpp::_["col"] = Rcpp::wrap(col_),
-        Rcpp::_["expected"] = Rcpp::wrap(expected_),
-        Rcpp::_["actual"] = Rcpp::wrap(actual_));
+        Rcpp::_["row"] = row,
+        Rcpp::_["col"] = col,
+        Rcpp::_["expected"] = expected,
+        Rcpp::_["actual"] = actual);
     out.attr("class") =
         Rcpp::CharacterVector::create("tbl_df", "tbl", "data.frame");
-    out.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER, -size());
+    out.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER, -(int)n);
+
+    if ((size_t)total_ > n) {
+      out.attr("n") = total_;
+      if (counts_.size() > 1) {
+        out.attr("col_counts") =
+            Rcpp::IntegerVector(counts_.begin() + 1, counts_.end());
+      }
+    }
 
     return out;
   }
 };
 
+// The number of problems kept by each read, from the readr.max_problems
+// option, or no limit if it is not set
+inline size_t maxProblemsOption() {
+  SEXP option = Rf_GetOption1(Rf_install("readr.max_problems"));
+  if (Rf_isNull(option))
+    return (size_t)INT_MAX;
+
+  int n = Rf_asInteger(option);
+  return (n == NA_INTEGER || n < 0) ? (size_t)INT_MAX : (size_t)n;
+}
+
 #endif
@@ -0,0 +1,27 @@
+#ifndef FASTREAD_ALTREP_H_
+#define FASTREAD_ALTREP_H_
+
+#include <R_ext/Rdynload.h>
+#include <Rversion.h>
+
+// ALTREP vectors need R 3.5.0 or later; without them the code that defines
+// them falls back to ordinary vectors
+
+#if R_VERSION >= R_Version(3, 5, 0)
+#define HAS_ALTREP
+#endif
+
+#if defined(HAS_ALTREP)
+#if R_VERSION < R_Version(3, 6, 0)
+// R 3.5's header isn't C++ safe: it uses class as a parameter name
+#define class klass
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
+#else
+#include <R_ext/Altrep.h>
+#endif
+#endif
+
+#endif
@@ -1189,6 +1189,63 @@ void tzset_name(const char * name) {
 
 }
 
+/*
+** readr: loads the transitions of time zone name into zone, without
+** touching the state used by my_mktime(), so that each caller can keep its
+** own copy. Falls back like tzset_name(). Returns 0 if the zone was loaded,
+** or -1 if it couldn't be found.
+*/
+int tz_load(const char * name, tz_transitions * const zone)
+{
+    struct state * sp = (struct state *) malloc(sizeof *sp);
+    int result = 0;
+
+    if (sp == NULL)
+        Rf_error("Failed to allocate time zone %s", name);
+
+    if (*name == '\0') {
+        sp->timecnt = 0;
+        sp->goback = sp->goahead = FALSE;
+        sp->ttis[0].tt_gmtoff = 0;
+        sp->defaulttype = 0;
+    } else if (tzload(name, sp, TRUE) != 0) {
+        Rf_warning("Failed to load tz %s: falling back to %s", name, gmt);
+        result = -1;
+
+        if (name[0] == ':' || tzparse(name, sp, FALSE) != 0)
+            gmtload(sp);
+    }
+
+    zone->count = sp->timecnt;
+    zone->at = (double *) malloc((sp->timecnt + 1) * sizeof(double));
+    zone->offset = (int *) malloc((sp->timecnt + 1) * sizeof(int));
+    if (zone->at == NULL || zone->offset == NULL) {
+        free(sp);
+        tz_free(zone);
+        Rf_error("Failed to allocate time zone %s", name);
+    }
+    for (int i = 0; i < sp->timecnt; ++i) {
+        zone->at[i] = (double) sp->ats[i];
+        zone->offset[i] = (int) sp->ttis[sp->types[i]].tt_gmtoff;
+    }
+    zone->default_offset = (int) sp->ttis[sp->defaulttype].tt_gmtoff;
+    zone->goback = sp->goback;
+    zone->goahead = sp->goahead;
+    zone->repeat = (double) SECSPERREPEAT;
+
+    free(sp);
+    return result;
+}
+
+void tz_free(tz_transitions * const zone)
+{
+    free(zone->at);
+    free(zone->offset);
+    zone->at = NULL;
+    zone->offset = NULL;
+    zone->count = 0;
+}
+
 void tzset(void) {
   tzset_name(getenv("TZ"));
 }
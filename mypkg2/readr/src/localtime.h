@@ -19,6 +19,23 @@ typedef struct Rtm stm;
 
 time_t my_mktime(stm* const tmp, const char* name);
 
+// The transitions of a time zone, in seconds since the epoch, and the offset
+// from UTC in seconds that applies after each one. If goback (goahead) is
+// set, times before the first (after the last) transition follow the same
+// rules as the times a multiple of repeat seconds later (earlier).
+typedef struct {
+  int count;
+  double* at;
+  int* offset;
+  int default_offset;
+  int goback;
+  int goahead;
+  double repeat;
+} tz_transitions;
+
+int tz_load(const char* name, tz_transitions* const zone);
+void tz_free(tz_transitions* const zone);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,26 @@ std::vector<int> count_fields_(List sourceSpec, List tokenizerSpec, int n_max) {
   return fields;
 }
 
+// [[Rcpp::export]]
+int count_records_(List sourceSpec, List tokenizerSpec) {
+  SourcePtr source = Source::create(sourceSpec);
+  TokenizerPtr tokenizer = Tokenizer::create(tokenizerSpec);
+
+  int records = tokenizer->countRecords(source->begin(), source->end());
+  if (records >= 0)
+    return records;
+
+  // Otherwise count the rows of the tokens
+  tokenizer->tokenize(source->begin(), source->end());
+  int rows = 0;
+  for (Token t = tokenizer->nextToken(); t.type() != TOKEN_EOF;
+       t = tokenizer->nextToken()) {
+    rows = t.row() + 1;
+  }
+
+  return rows;
+}
+
 // [[Rcpp::export]]
 RObject guess_header_(List sourceSpec, List tokenizerSpec, List locale_) {
   Warnings warnings;
@@ -103,7 +123,7 @@ RObject tokenize_(List sourceSpec, List tokenizerSpec, int n_max) {
     if (t.col() >= row.size())
       row.resize(t.col() + 1);
 
-    row[t.col()] = t.asString();
+    row[t.col()] = t.asString(&warnings);
   }
 
   RObject out = wrap(rows);
@@ -118,9 +138,11 @@ SEXP parse_vector_(
     const std::vector<std::string>& na,
     const bool trim_ws = true) {
   Warnings warnings;
+  warnings.setMaxProblems(maxProblemsOption());
   int n = x.size();
 
   LocaleInfo locale(locale_);
+  NaMatcher NA(na);
 
   boost::shared_ptr<Collector> col = Collector::create(collectorSpec, &locale);
   col->setWarnings(&warnings);
@@ -136,7 +158,7 @@ SEXP parse_vector_(
       if (trim_ws) {
         t.trim();
       }
-      t.flagNA(na);
+      t.flagNA(NA);
     }
     col->setValue(i, t);
   }
@@ -5,10 +5,19 @@ using namespace Rcpp;
 #include "LocaleInfo.h"
 #include "Progress.h"
 #include "Reader.h"
+#include "RowFilter.h"
 #include "Source.h"
+#include "TokenBatch.h"
 #include "Tokenizer.h"
 #include "TokenizerLine.h"
 #include "Warnings.h"
+#include "utils.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // [[Rcpp::export]]
 CharacterVector read_file_(List sourceSpec, List locale_) {
@@ -136,16 +145,29 @@ RObject read_tokens_(
     ListOf<List> colSpecs,
     CharacterVector colNames,
     List locale_,
+    ListOf<List> filterSpecs,
     int n_max = -1,
-    bool progress = true) {
+    bool progress = true,
+    int num_threads = 1,
+    bool lazy = false,
+    int promote = 0) {
 
-  LocaleInfo l(locale_);
+  // Lazy and promoted columns keep the locale until they are converted
+  LocaleInfoPtr pLocale(new LocaleInfo(locale_));
   Reader r(
       Source::create(sourceSpec),
       Tokenizer::create(tokenizerSpec),
-      collectorsCreate(colSpecs, &l),
+      collectorsCreate(colSpecs, pLocale.get()),
       progress,
-      colNames);
+      colNames,
+      num_threads,
+      RowFilter(filterSpecs, pLocale.get()));
+  if (lazy) {
+    r.setLazy(pLocale);
+  }
+  if (promote > 0) {
+    r.setPromote(pLocale, promote);
+  }
 
   return r.readToDataFrame(n_max);
 }
@@ -159,7 +181,9 @@ void read_tokens_chunked_(
     ListOf<List> colSpecs,
     CharacterVector colNames,
     List locale_,
-    bool progress = true) {
+    ListOf<List> filterSpecs,
+    bool progress = true,
+    int num_threads = 1) {
 
   LocaleInfo l(locale_);
   Reader r(
@@ -167,7 +191,9 @@ void read_tokens_chunked_(
       Tokenizer::create(tokenizerSpec),
       collectorsCreate(colSpecs, &l),
       progress,
-      colNames);
+      colNames,
+      num_threads,
+      RowFilter(filterSpecs, &l));
 
   int pos = 1;
   while (isTrue(R6method(callback, "continue")())) {
@@ -182,36 +208,172 @@ void read_tokens_chunked_(
   return;
 }
 
+// Records read from one part of the input to guess the column types from
+struct GuessSample {
+  SourceIterator begin, end;
+  TokenBatch tokens;
+  Warnings warnings;
+
+  // The clone that read the tokens, kept so that they are unescaped by a
+  // tokenizer that was run on the input
+  TokenizerPtr tokenizer;
+
+  // Did the records run past the start of the next sample?
+  bool overlaps;
+
+  void tokenize(const Tokenizer& prototype, int n, SourceIterator sourceEnd) {
+    tokenizer = prototype.clone();
+    tokenizer->setWarnings(&warnings);
+    tokenizer->tokenize(begin, sourceEnd);
+    tokenizer->nextBatch(&tokens, n);
+
+    overlaps = begin + tokenizer->progress().second > end;
+  }
+
+  // The number of fields of the record whose first token is *pToken, which
+  // is moved to the first token of the next record
+  int fields(size_t* pToken) const {
+    int row = tokens.row(*pToken), n = 0;
+    for (; *pToken < tokens.size() && tokens.row(*pToken) == row; ++*pToken)
+      n = std::max(n, tokens.col(*pToken) + 1);
+    return n;
+  }
+};
+
+// Reads n records in all from samples places spread evenly through the input,
+// each starting at the line following its offset, with up to numThreads
+// threads. Returns false if the input is too short to sample without the
+// samples running into each other.
+//
+// A sample may start inside a quoted field, so those after the first are only
+// used if the tokenizer raised no problems and every record has as many
+// fields as the first record of the input.
+static bool sampleTokens(
+    Tokenizer* pPrototype,
+    SourceIterator begin,
+    SourceIterator end,
+    int n,
+    int samples,
+    int numThreads,
+    std::vector<CollectorPtr>* pCollectors,
+    Warnings* pWarnings,
+    Iconv* pEncoder) {
+  int rows = (n + samples - 1) / samples;
+
+  std::vector<GuessSample> sample(samples);
+  for (int k = 0; k < samples; ++k) {
+    sample[k].begin = (k == 0)
+                          ? begin
+                          : nextLineStart(begin + (end - begin) / samples * k,
+                                          end);
+  }
+  for (int k = 0; k < samples; ++k) {
+    sample[k].end = (k + 1 < samples) ? sample[k + 1].begin : end;
+  }
+
+#ifdef _OPENMP
+  int threads = std::max(1, std::min(samples, numThreads));
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+  for (int k = 0; k < samples; ++k) {
+    sample[k].tokenize(*pPrototype, rows, end);
+  }
+
+  for (int k = 0; k < samples; ++k) {
+    if (sample[k].overlaps)
+      return false;
+  }
+
+  size_t first = 0;
+  int ncol = sample[0].tokens.empty() ? 0 : sample[0].fields(&first);
+
+  std::vector<CollectorPtr>& collectors = *pCollectors;
+  for (int k = 0; k < samples; ++k) {
+    const TokenBatch& tokens = sample[k].tokens;
+
+    if (k > 0) {
+      bool ok = sample[k].warnings.size() == 0;
+      for (size_t i = 0; ok && i < tokens.size();) {
+        ok = sample[k].fields(&i) == ncol;
+      }
+      if (!ok)
+        continue;
+    }
+
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      Token t = tokens.token(i);
+
+      // A sample whose first record isn't on row 0 may have tokens past its
+      // rows
+      if (t.row() >= (size_t)rows)
+        break;
+
+      // Add new collectors, if needed
+      while (t.col() >= collectors.size()) {
+        CollectorPtr col = CollectorPtr(new CollectorCharacter(pEncoder));
+        col->setWarnings(pWarnings);
+        col->resize(rows * samples);
+        collectors.push_back(col);
+      }
+
+      collectors[t.col()]->setValue(k * rows + t.row(), t);
+    }
+  }
+
+  return true;
+}
+
 // [[Rcpp::export]]
 std::vector<std::string> guess_types_(
-    List sourceSpec, List tokenizerSpec, Rcpp::List locale_, int n = 100) {
+    List sourceSpec,
+    List tokenizerSpec,
+    Rcpp::List locale_,
+    int n = 100,
+    int samples = 1,
+    int num_threads = 1) {
   Warnings warnings;
   SourcePtr source = Source::create(sourceSpec);
   TokenizerPtr tokenizer = Tokenizer::create(tokenizerSpec);
-  tokenizer->tokenize(source->begin(), source->end());
   tokenizer->setWarnings(&warnings); // silence warnings
 
   LocaleInfo locale(locale_);
 
   std::vector<CollectorPtr> collectors;
-  for (Token t = tokenizer->nextToken(); t.type() != TOKEN_EOF;
-       t = tokenizer->nextToken()) {
-    if (t.row() >= (size_t)n)
-      break;
-
-    // Add new collectors, if needed
-    if (t.col() >= collectors.size()) {
-      int p = collectors.size() - t.col() + 1;
-      for (int j = 0; j < p; ++j) {
-        CollectorPtr col =
-            CollectorPtr(new CollectorCharacter(&locale.encoder_));
-        col->setWarnings(&warnings);
-        col->resize(n);
-        collectors.push_back(col);
+  bool sampled = samples > 1 && n >= samples && tokenizer->canClone() &&
+                 sampleTokens(
+                     tokenizer.get(),
+                     source->begin(),
+                     source->end(),
+                     n,
+                     samples,
+                     num_threads,
+                     &collectors,
+                     &warnings,
+                     &locale.encoder_);
+
+  if (!sampled) {
+    collectors.clear();
+    tokenizer->tokenize(source->begin(), source->end());
+
+    for (Token t = tokenizer->nextToken(); t.type() != TOKEN_EOF;
+         t = tokenizer->nextToken()) {
+      if (t.row() >= (size_t)n)
+        break;
+
+      // Add new collectors, if needed
+      if (t.col() >= collectors.size()) {
+        int p = collectors.size() - t.col() + 1;
+        for (int j = 0; j < p; ++j) {
+          CollectorPtr col =
+              CollectorPtr(new CollectorCharacter(&locale.encoder_));
+          col->setWarnings(&warnings);
+          col->resize(n);
+          collectors.push_back(col);
+        }
       }
-    }
 
-    collectors[t.col()]->setValue(t.row(), t);
+      collectors[t.col()]->setValue(t.row(), t);
+    }
   }
 
   std::vector<std::string> out;
@@ -14,6 +14,7 @@ RObject type_convert_col(
     const std::vector<std::string>& na,
     bool trim_ws) {
   LocaleInfo locale(locale_);
+  NaMatcher NA(na);
 
   CollectorPtr collector = Collector::create(spec, &locale);
   collector->resize(x.size());
@@ -29,7 +30,7 @@ RObject type_convert_col(
       t = Token(begin, begin + Rf_length(string), i - 1, col - 1, false);
       if (trim_ws)
         t.trim();
-      t.flagNA(na);
+      t.flagNA(NA);
     }
 
     collector->setValue(i, t);
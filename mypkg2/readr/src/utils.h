@@ -14,4 +14,16 @@ template <class Iter> inline Iter advanceForLF(Iter* pBegin, Iter end) {
   return cur;
 }
 
+// Start of the line following cur, or end if there is none
+template <class Iter> inline Iter nextLineStart(Iter cur, Iter end) {
+  while (cur != end && *cur != '\n' && *cur != '\r') {
+    ++cur;
+  }
+  if (cur == end)
+    return end;
+
+  advanceForLF(&cur, end);
+  return cur + 1;
+}
+
 #endif